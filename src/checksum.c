@@ -0,0 +1,321 @@
+/*
+ * Checksums
+ *
+ * CRC-32, Adler-32 and SHA-256 over a file in one read pass, all
+ * selected digests fed from the same chunk.
+ *
+ * CRC-32 goes slice-by-8: eight 256-entry tables (8 KB, built on
+ * first use) let each step fold in eight bytes with two aligned word
+ * loads instead of eight dependent table lookups. The words are read
+ * little-endian, as the Nspire's ARM runs. Adler-32 defers its
+ * modulo for as long as the sums cannot overflow (5552 bytes).
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "checksum.h"
+#include "fs.h"
+#include "ui.h"
+#include "input.h"
+
+#ifndef CHECKSUM_CHUNK
+#define CHECKSUM_CHUNK 32768
+#endif
+
+#ifndef CHECKSUM_RTC_SECONDS
+#define CHECKSUM_RTC_SECONDS() (*(volatile unsigned *)0x90090000)
+#endif
+
+#define ADLER_MOD 65521
+#define ADLER_NMAX 5552 // Most bytes before b can overflow 32 bits
+
+static uint32_t crc_tables[8][256];
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_tables[0][i] = c;
+    }
+    // Table k advances a byte through k more zero bytes
+    for (int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t c = crc_tables[k - 1][i];
+            crc_tables[k][i] = (c >> 8) ^ crc_tables[0][c & 0xFF];
+        }
+    }
+}
+
+uint32_t checksum_crc32(uint32_t crc, const unsigned char *buf, size_t len) {
+    const uint32_t (*t)[256] = crc_tables;
+    if (!t[0][1]) crc_init();
+    crc = ~crc;
+
+    // Bytewise up to a word boundary, then eight bytes per step
+    while (len && ((uintptr_t)buf & 3)) {
+        crc = t[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t one = *(const uint32_t *)buf ^ crc;
+        uint32_t two = *(const uint32_t *)(buf + 4);
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^
+              t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^
+              t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) crc = t[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t checksum_adler32(uint32_t adler, const unsigned char *buf, size_t len) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    while (len > 0) {
+        size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+        len -= n;
+        while (n >= 4) {
+            a += buf[0]; b += a;
+            a += buf[1]; b += a;
+            a += buf[2]; b += a;
+            a += buf[3]; b += a;
+            buf += 4;
+            n -= 4;
+        }
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+/*
+ * SHA-256 (FIPS 180-4)
+ */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(sha256_t *s, const unsigned char *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+               ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = s->state[0], b = s->state[1], c = s->state[2], d = s->state[3];
+    uint32_t e = s->state[4], f = s->state[5], g = s->state[6], h = s->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s->state[0] += a; s->state[1] += b; s->state[2] += c; s->state[3] += d;
+    s->state[4] += e; s->state[5] += f; s->state[6] += g; s->state[7] += h;
+}
+
+void sha256_init(sha256_t *s) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(s->state, initial, sizeof(initial));
+    s->length = 0;
+    s->used = 0;
+}
+
+void sha256_update(sha256_t *s, const unsigned char *buf, size_t len) {
+    s->length += len;
+    if (s->used) {
+        size_t room = 64 - s->used;
+        size_t n = room < len ? room : len;
+        memcpy(s->block + s->used, buf, n);
+        s->used += n;
+        buf += n;
+        len -= n;
+        if (s->used < 64) return;
+        sha256_block(s, s->block);
+        s->used = 0;
+    }
+    // Whole blocks straight from the caller's buffer
+    while (len >= 64) {
+        sha256_block(s, buf);
+        buf += 64;
+        len -= 64;
+    }
+    memcpy(s->block, buf, len);
+    s->used = len;
+}
+
+void sha256_final(sha256_t *s, unsigned char digest[32]) {
+    uint64_t bits = s->length * 8;
+    s->block[s->used++] = 0x80;
+    if (s->used > 56) {
+        memset(s->block + s->used, 0, 64 - s->used);
+        sha256_block(s, s->block);
+        s->used = 0;
+    }
+    memset(s->block + s->used, 0, 56 - s->used);
+    for (int i = 0; i < 8; i++) s->block[56 + i] = bits >> (56 - 8 * i);
+    sha256_block(s, s->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = s->state[i] >> 24;
+        digest[4 * i + 1] = s->state[i] >> 16;
+        digest[4 * i + 2] = s->state[i] >> 8;
+        digest[4 * i + 3] = s->state[i];
+    }
+}
+
+int checksum_file(const char *path, int which, checksum_result_t *result,
+                  checksum_progress_fn progress, void *user) {
+    memset(result, 0, sizeof(*result));
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    unsigned char *buf = malloc(CHECKSUM_CHUNK);
+    if (!buf) {
+        fclose(f);
+        return -1;
+    }
+
+    struct stat st;
+    unsigned long total = stat(path, &st) == 0 ? (unsigned long)st.st_size : 0;
+    uint32_t crc = 0;
+    uint32_t adler = 1;
+    sha256_t sha;
+    sha256_init(&sha);
+
+    unsigned int start = CHECKSUM_RTC_SECONDS();
+    size_t n;
+    while ((n = fread(buf, 1, CHECKSUM_CHUNK, f)) > 0) {
+        if (which & CHECKSUM_CRC32) crc = checksum_crc32(crc, buf, n);
+        if (which & CHECKSUM_ADLER32) adler = checksum_adler32(adler, buf, n);
+        if (which & CHECKSUM_SHA256) sha256_update(&sha, buf, n);
+        result->bytes += n;
+        if (progress) progress(user, result->bytes, total);
+    }
+    result->seconds = CHECKSUM_RTC_SECONDS() - start;
+    int failed = ferror(f);
+
+    result->crc32 = crc;
+    result->adler32 = adler;
+    if (which & CHECKSUM_SHA256) sha256_final(&sha, result->sha256);
+    free(buf);
+    fclose(f);
+    return failed ? -1 : 0;
+}
+
+/*
+ * Checksum dialog
+ */
+
+static void hash_progress(void *user, unsigned long done, unsigned long total) {
+    int *last = (int *)user;
+    int percent = total ? (int)((unsigned long long)done * 100 / total) : 100;
+    if (percent == *last) return;
+    *last = percent;
+    ui_draw_progress("Hashing", percent);
+}
+
+static void show_results(const char *path, int which, const checksum_result_t *r) {
+    char lines[7][64];
+    const char *shown[7];
+    int count = 0;
+
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(lines[count++], 64, "%.48s", base);
+    if (which & CHECKSUM_CRC32) snprintf(lines[count++], 64, "CRC32    %08lx", (unsigned long)r->crc32);
+    if (which & CHECKSUM_ADLER32) snprintf(lines[count++], 64, "Adler32  %08lx", (unsigned long)r->adler32);
+    if (which & CHECKSUM_SHA256) {
+        // 64 hex digits take two lines
+        char hex[65];
+        for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", r->sha256[i]);
+        snprintf(lines[count++], 64, "SHA-256  %.32s", hex);
+        snprintf(lines[count++], 64, "         %.32s", hex + 32);
+    }
+
+    // Throughput over whole RTC seconds; a short run is below resolution
+    if (r->seconds == 0)
+        snprintf(lines[count++], 64, "%lu KB in under 1 s", r->bytes / 1024);
+    else
+        snprintf(lines[count++], 64, "%lu KB in %u s, %lu KB/s", r->bytes / 1024, r->seconds,
+                 r->bytes / 1024 / r->seconds);
+
+    for (int i = 0; i < count; i++) shown[i] = lines[i];
+    ui_draw_lines(shown, count);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
+void checksum_view(const char *path) {
+    static int which = CHECKSUM_CRC32 | CHECKSUM_ADLER32 | CHECKSUM_SHA256;
+    int opt_sel = 0;
+
+    while (1) {
+        char labels[5][24];
+        const char *options[5];
+        snprintf(labels[0], sizeof(labels[0]), "[%c] CRC32", (which & CHECKSUM_CRC32) ? 'x' : ' ');
+        snprintf(labels[1], sizeof(labels[1]), "[%c] Adler32", (which & CHECKSUM_ADLER32) ? 'x' : ' ');
+        snprintf(labels[2], sizeof(labels[2]), "[%c] SHA-256", (which & CHECKSUM_SHA256) ? 'x' : ' ');
+        snprintf(labels[3], sizeof(labels[3]), "[%c] Verify copies", fs_verify_copies ? 'x' : ' ');
+        snprintf(labels[4], sizeof(labels[4]), "Start");
+        for (int i = 0; i < 5; i++) options[i] = labels[i];
+        ui_draw_menu(options, 5, opt_sel);
+
+        int m = input_get_key();
+        if (m == NIO_KEY_DOWN) {
+            opt_sel = (opt_sel + 1) % 5;
+        } else if (m == NIO_KEY_UP) {
+            opt_sel = (opt_sel + 4) % 5;
+        } else if (m == NIO_KEY_ESC || m == NIO_KEY_LEFT || m == NIO_KEY_MENU) {
+            return;
+        } else if (m == NIO_KEY_ENTER) {
+            if (opt_sel < 3) which ^= 1 << opt_sel;
+            else if (opt_sel == 3) fs_verify_copies = !fs_verify_copies;
+            else if (which) break;
+        }
+    }
+
+    int last = -1;
+    checksum_result_t result;
+    hash_progress(&last, 0, 1);
+    if (checksum_file(path, which, &result, hash_progress, &last) != 0) {
+        ui_draw_modal("Read failed");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    show_results(path, which, &result);
+}
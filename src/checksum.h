@@ -0,0 +1,47 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Running CRC-32 (IEEE, as in zip and PNG). Start from 0.
+uint32_t checksum_crc32(uint32_t crc, const unsigned char *buf, size_t len);
+
+// Running Adler-32 (as in zlib). Start from 1.
+uint32_t checksum_adler32(uint32_t adler, const unsigned char *buf, size_t len);
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;        // Bytes hashed so far
+    unsigned char block[64];
+    int used;               // Bytes waiting in block
+} sha256_t;
+
+void sha256_init(sha256_t *s);
+void sha256_update(sha256_t *s, const unsigned char *buf, size_t len);
+void sha256_final(sha256_t *s, unsigned char digest[32]);
+
+#define CHECKSUM_CRC32 1
+#define CHECKSUM_ADLER32 2
+#define CHECKSUM_SHA256 4
+
+typedef struct {
+    uint32_t crc32;
+    uint32_t adler32;
+    unsigned char sha256[32];
+    unsigned long bytes;
+    unsigned int seconds; // Elapsed, in whole RTC seconds
+} checksum_result_t;
+
+// Called while checksum_file runs, with the bytes read so far out of total
+typedef void (*checksum_progress_fn)(void *user, unsigned long done, unsigned long total);
+
+// Compute the digests selected in which (CHECKSUM_ flags) in one
+// read pass. Returns 0, or -1 if the file cannot be read.
+int checksum_file(const char *path, int which, checksum_result_t *result,
+                  checksum_progress_fn progress, void *user);
+
+// Pick digests, compute them over path and show the results
+void checksum_view(const char *path);
+
+#endif
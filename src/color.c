@@ -0,0 +1,184 @@
+/*
+ * Color conversion
+ *
+ * RGB888 to RGB565, one row at a time, with optional dithering so
+ * gradients do not band. All per-pixel arithmetic is done through
+ * tables built on first use:
+ * - ordered: for each of the 16 Bayer thresholds, the pre-shifted
+ *   RGB565 field of every channel value (24 KB)
+ * - diffusion: quantize/expand tables per channel depth and a clamp
+ *   table for value + error
+ * - gray: 4-bit level per threshold and luminance (4 KB), plus the
+ *   nearest level without dithering, for the 4bpp screens of the
+ *   grayscale models
+ */
+
+#include <string.h>
+#include "color.h"
+
+#define MAX_ROW 320
+
+static int dither_mode = COLOR_DITHER_DIFFUSE;
+static int tables_ready = 0;
+
+// Ordered dither: [threshold][value] -> field already in position
+static uint16_t ordered_r[16][256];
+static uint16_t ordered_g[16][256];
+static uint16_t ordered_b[16][256];
+
+static const unsigned char bayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+// Error diffusion
+static unsigned char clamp_tab[256 * 3]; // [v + 256] -> 0..255
+static unsigned char quant5[256], quant6[256];
+static unsigned char expand5[32], expand6[64];
+static short err_rows[2][(MAX_ROW + 2) * 3]; // Current and next row
+static int err_cur = 0;
+
+// Gray: [threshold][luma] -> 4-bit level
+static unsigned char ordered_gray[16][256];
+static unsigned char nearest_gray[256];
+
+static void build_tables(void) {
+    for (int t = 0; t < 16; t++) {
+        for (int v = 0; v < 256; v++) {
+            // Threshold in (0, 1) of a quantization step: (t + 0.5) / 16
+            int bias = ((2 * t + 1) * 255) / 32;
+            int r = (v * 31 + bias) / 255;
+            int g = (v * 63 + bias) / 255;
+            ordered_r[t][v] = r << 11;
+            ordered_g[t][v] = g << 5;
+            ordered_b[t][v] = r;
+            ordered_gray[t][v] = (v * 15 + bias) / 255;
+        }
+    }
+
+    for (int i = 0; i < 256 * 3; i++) {
+        int v = i - 256;
+        clamp_tab[i] = v < 0 ? 0 : (v > 255 ? 255 : v);
+    }
+    for (int v = 0; v < 256; v++) {
+        // Nearest level rather than truncation
+        quant5[v] = (v * 31 + 127) / 255;
+        quant6[v] = (v * 63 + 127) / 255;
+        nearest_gray[v] = (v * 15 + 127) / 255;
+    }
+    for (int q = 0; q < 32; q++) expand5[q] = (q << 3) | (q >> 2);
+    for (int q = 0; q < 64; q++) expand6[q] = (q << 2) | (q >> 4);
+
+    tables_ready = 1;
+}
+
+int color_get_dither(void) {
+    return dither_mode;
+}
+
+void color_set_dither(int mode) {
+    if (mode >= 0 && mode < COLOR_DITHER_COUNT) dither_mode = mode;
+}
+
+const char *color_dither_name(int mode) {
+    if (mode == COLOR_DITHER_ORDERED) return "Ordered";
+    if (mode == COLOR_DITHER_DIFFUSE) return "Diffusion";
+    return "None";
+}
+
+void color_diffuse_start(void) {
+    memset(err_rows, 0, sizeof(err_rows));
+    err_cur = 0;
+}
+
+/*
+ * Floyd-Steinberg on one row. Errors for this row are read from
+ * err_rows[err_cur] and pushed into the other one (offset by one
+ * pixel so x - 1 never goes out of range).
+ */
+static void diffuse_row(const unsigned char *rgb, uint16_t *out, int n) {
+    short *cur = err_rows[err_cur] + 3;
+    short *next = err_rows[err_cur ^ 1] + 3;
+    memset(next - 3, 0, sizeof(err_rows[0]));
+
+    for (int i = 0; i < n; i++, rgb += 3) {
+        int r = clamp_tab[rgb[0] + cur[i * 3] / 16 + 256];
+        int g = clamp_tab[rgb[1] + cur[i * 3 + 1] / 16 + 256];
+        int b = clamp_tab[rgb[2] + cur[i * 3 + 2] / 16 + 256];
+        int qr = quant5[r], qg = quant6[g], qb = quant5[b];
+        out[i] = (qr << 11) | (qg << 5) | qb;
+
+        // Errors are kept in 16ths: 7 right, 3 below-left, 5 below, 1 below-right
+        int er = r - expand5[qr], eg = g - expand6[qg], eb = b - expand5[qb];
+        cur[i * 3 + 3] += er * 7;
+        cur[i * 3 + 4] += eg * 7;
+        cur[i * 3 + 5] += eb * 7;
+        next[i * 3 - 3] += er * 3;
+        next[i * 3 - 2] += eg * 3;
+        next[i * 3 - 1] += eb * 3;
+        next[i * 3] += er * 5;
+        next[i * 3 + 1] += eg * 5;
+        next[i * 3 + 2] += eb * 5;
+        next[i * 3 + 3] += er;
+        next[i * 3 + 4] += eg;
+        next[i * 3 + 5] += eb;
+    }
+    err_cur ^= 1;
+}
+
+void color_row_565(const unsigned char *rgb, uint16_t *out, int n, int x, int y, int mode) {
+    if (mode == COLOR_DITHER_NONE) {
+        for (int i = 0; i < n; i++, rgb += 3) {
+            out[i] = ((rgb[0] & 0xF8) << 8) | ((rgb[1] & 0xFC) << 3) | (rgb[2] >> 3);
+        }
+        return;
+    }
+
+    if (!tables_ready) build_tables();
+
+    if (mode == COLOR_DITHER_DIFFUSE && n <= MAX_ROW) {
+        diffuse_row(rgb, out, n);
+        return;
+    }
+
+    // Ordered: the four thresholds of this row, in pattern order
+    const unsigned char *pattern = bayer4[y & 3];
+    for (int i = 0; i < n; i++, rgb += 3) {
+        int t = pattern[(x + i) & 3];
+        out[i] = ordered_r[t][rgb[0]] | ordered_g[t][rgb[1]] | ordered_b[t][rgb[2]];
+    }
+}
+
+void color_row_gray4(const unsigned char *luma, unsigned char *row, int n, int x, int y, int mode) {
+    if (!tables_ready) build_tables();
+
+    // Without dithering, the nearest level (no Bayer threshold sits
+    // exactly halfway)
+    const unsigned char *pattern = bayer4[y & 3];
+    for (int i = 0; i < n; i++) {
+        int px = x + i;
+        int level = (mode == COLOR_DITHER_NONE) ? nearest_gray[luma[i]] : ordered_gray[pattern[px & 3]][luma[i]];
+        unsigned char *p = row + (px >> 1);
+        if (px & 1) *p = (*p & 0xF0) | level;
+        else *p = (*p & 0x0F) | (level << 4);
+    }
+}
+
+void color_565_to_gray4(const uint16_t *src, unsigned char *dst, int w, int h, int mode) {
+    unsigned char luma[MAX_ROW];
+    if (w > MAX_ROW) return;
+
+    // Row by row: dst row y ends before src row y starts, so dst may be src
+    for (int y = 0; y < h; y++) {
+        const uint16_t *s = src + y * w;
+        for (int x = 0; x < w; x++) {
+            int r = (s[x] >> 8) & 0xF8;
+            int g = (s[x] >> 3) & 0xFC;
+            int b = (s[x] << 3) & 0xF8;
+            luma[x] = COLOR_LUMA(r, g, b);
+        }
+        color_row_gray4(luma, dst + y * (w / 2), w, 0, y, mode);
+    }
+}
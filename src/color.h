@@ -0,0 +1,37 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+
+// Dithering modes for RGB888 -> RGB565
+#define COLOR_DITHER_NONE 0    // Truncation
+#define COLOR_DITHER_ORDERED 1 // 4x4 Bayer
+#define COLOR_DITHER_DIFFUSE 2 // Floyd-Steinberg
+#define COLOR_DITHER_COUNT 3
+
+int color_get_dither(void);
+void color_set_dither(int mode);
+const char *color_dither_name(int mode);
+
+// Reset the error-diffusion state before the first row of an image
+void color_diffuse_start(void);
+
+// Convert one row of n RGB888 pixels to RGB565. (x, y) is the
+// position of the first pixel, which aligns the ordered pattern.
+// COLOR_DITHER_DIFFUSE expects consecutive rows after
+// color_diffuse_start and falls back to ordered for rows that are
+// wider than the screen.
+void color_row_565(const unsigned char *rgb, uint16_t *out, int n, int x, int y, int mode);
+
+// Luminance (BT.601 weights, 0..255) for scalers writing gray directly
+#define COLOR_LUMA(r, g, b) (((r) * 77 + (g) * 150 + (b) * 29) >> 8)
+
+// Write n luminance values as 4bpp gray into the screen row `row`
+// (two pixels per byte, left pixel in the high nibble), starting at
+// pixel x. Dithering is ordered for both dithering modes.
+void color_row_gray4(const unsigned char *luma, unsigned char *row, int n, int x, int y, int mode);
+
+// Convert a w x h RGB565 buffer to 4bpp gray. dst may be src.
+void color_565_to_gray4(const uint16_t *src, unsigned char *dst, int w, int h, int mode);
+
+#endif
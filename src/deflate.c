@@ -0,0 +1,521 @@
+/*
+ * Streaming deflate
+ *
+ * Raw DEFLATE (RFC 1951) encoder, the counterpart of inflate.c, for
+ * writing zip members without loading them. Input is read into a
+ * 64 KB window; matches are found through 3-byte hash chains
+ * (greedy, at most DEFLATE_MAX_CHAIN candidates per position) and
+ * buffered as symbols. Each block is then written stored, with the
+ * fixed codes or with its own Huffman codes, whichever is smallest,
+ * so incompressible data grows by a few bytes per block at most.
+ *
+ * A block ends when the symbol buffer is full or the window has to
+ * slide, which keeps the block's raw bytes in the window for the
+ * stored case.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "deflate.h"
+
+#define WSIZE 32768
+#define WMASK (WSIZE - 1)
+#define HASH_BITS 14
+#define HASH_SIZE (1 << HASH_BITS)
+#define HASH_MASK (HASH_SIZE - 1)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MIN_LOOKAHEAD (MAX_MATCH + MIN_MATCH + 1)
+#define MAX_DIST (WSIZE - MIN_LOOKAHEAD)
+#define SYM_BUF 16384
+#define OUT_SIZE 4096
+#define NICE_MATCH 128
+
+// Speed/ratio trade-off: candidates tried per position
+#ifndef DEFLATE_MAX_CHAIN
+#define DEFLATE_MAX_CHAIN 64
+#endif
+
+#define LIT_CODES 286
+#define DIST_CODES 30
+#define CL_CODES 19
+
+typedef struct {
+    deflate_read_fn read;
+    void *read_user;
+    deflate_write_fn write;
+    void *write_user;
+    int error;
+
+    // Window: the previous 32 KB and the lookahead. Hash chains hold
+    // window positions, 0 meaning none.
+    unsigned char window[2 * WSIZE];
+    uint16_t head[HASH_SIZE];
+    uint16_t prev[WSIZE];
+    int strstart;
+    int lookahead;
+    int block_start;
+    int eof;
+
+    // Symbols of the current block: a literal (dist 0) or a match
+    // (length - 3, dist)
+    uint8_t sym_lit[SYM_BUF];
+    uint16_t sym_dist[SYM_BUF];
+    int sym_count;
+    unsigned int lit_freq[LIT_CODES];
+    unsigned int dist_freq[DIST_CODES];
+
+    // Output
+    unsigned char out[OUT_SIZE];
+    int out_len;
+    uint32_t bit_buf;
+    int bit_count;
+} deflate_t;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t cl_order[CL_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Length (3..258) and distance (1..32768) to their codes, built on first use
+static uint8_t length_code[MAX_MATCH + 1];
+static uint8_t dist_code_lo[256]; // Distances 1..256
+static uint8_t dist_code_hi[256]; // Distances 257..32768, by (dist - 1) >> 7
+
+static void build_code_tables(void) {
+    for (int c = 0; c < 29; c++) {
+        for (int l = length_base[c]; l < length_base[c] + (1 << length_extra[c]) && l <= MAX_MATCH; l++) {
+            length_code[l] = c;
+        }
+    }
+    length_code[MAX_MATCH] = 28;
+    for (int c = 0; c < 30; c++) {
+        for (int d = dist_base[c]; d < dist_base[c] + (1 << dist_extra[c]); d++) {
+            if (d <= 256) dist_code_lo[d - 1] = c;
+            else dist_code_hi[(d - 1) >> 7] = c;
+        }
+    }
+}
+
+static int dist_code(int dist) {
+    return dist <= 256 ? dist_code_lo[dist - 1] : dist_code_hi[(dist - 1) >> 7];
+}
+
+/*
+ * Output
+ */
+static void flush_out(deflate_t *s) {
+    if (s->out_len && !s->error && s->write(s->write_user, s->out, s->out_len) != 0) {
+        s->error = DEFLATE_ERR_IO;
+    }
+    s->out_len = 0;
+}
+
+static void put_bits(deflate_t *s, uint32_t value, int n) {
+    s->bit_buf |= value << s->bit_count;
+    s->bit_count += n;
+    while (s->bit_count >= 8) {
+        s->out[s->out_len++] = s->bit_buf & 0xFF;
+        if (s->out_len == OUT_SIZE) flush_out(s);
+        s->bit_buf >>= 8;
+        s->bit_count -= 8;
+    }
+}
+
+static void align_byte(deflate_t *s) {
+    if (s->bit_count) put_bits(s, 0, 8 - s->bit_count);
+}
+
+/*
+ * Huffman code lengths for freq[0..n), two-queue construction over
+ * the symbols sorted by frequency. Returns the longest length.
+ */
+static int huffman_lengths(const unsigned int *freq, int n, uint8_t *lens) {
+    int leaves[LIT_CODES];
+    unsigned int node_freq[LIT_CODES];
+    int leaf_parent[LIT_CODES], node_parent[LIT_CODES], depth[LIT_CODES];
+    int m = 0;
+
+    memset(lens, 0, n);
+    for (int i = 0; i < n; i++) {
+        if (!freq[i]) continue;
+        // Insertion sort: at most 286 symbols
+        int j = m++;
+        while (j > 0 && freq[leaves[j - 1]] > freq[i]) {
+            leaves[j] = leaves[j - 1];
+            j--;
+        }
+        leaves[j] = i;
+    }
+    if (m == 0) return 0;
+    if (m == 1) {
+        lens[leaves[0]] = 1;
+        return 1;
+    }
+
+    // Internal nodes are created in nondecreasing frequency order
+    int li = 0, ni = 0;
+    for (int k = 0; k < m - 1; k++) {
+        unsigned int sum = 0;
+        for (int pick = 0; pick < 2; pick++) {
+            if (li < m && (ni >= k || freq[leaves[li]] <= node_freq[ni])) {
+                sum += freq[leaves[li]];
+                leaf_parent[li++] = k;
+            } else {
+                sum += node_freq[ni];
+                node_parent[ni++] = k;
+            }
+        }
+        node_freq[k] = sum;
+    }
+
+    int max_len = 0;
+    depth[m - 2] = 0;
+    for (int k = m - 3; k >= 0; k--) depth[k] = depth[node_parent[k]] + 1;
+    for (int i = 0; i < m; i++) {
+        int len = depth[leaf_parent[i]] + 1;
+        lens[leaves[i]] = len;
+        if (len > max_len) max_len = len;
+    }
+    return max_len;
+}
+
+/*
+ * Code lengths no longer than limit: frequencies are flattened until
+ * the tree is shallow enough.
+ */
+static void limited_lengths(const unsigned int *freq, int n, int limit, uint8_t *lens) {
+    unsigned int f[LIT_CODES];
+    memcpy(f, freq, n * sizeof(unsigned int));
+    while (huffman_lengths(f, n, lens) > limit) {
+        for (int i = 0; i < n; i++) {
+            if (f[i]) f[i] = (f[i] >> 1) | 1;
+        }
+    }
+}
+
+/*
+ * Canonical codes for the lengths, bit-reversed for LSB-first output.
+ */
+static void canonical_codes(const uint8_t *lens, int n, uint16_t *codes) {
+    int count[16] = { 0 };
+    int next[16];
+    for (int i = 0; i < n; i++) count[lens[i]]++;
+    count[0] = 0;
+    int code = 0;
+    for (int len = 1; len < 16; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (int i = 0; i < n; i++) {
+        int len = lens[i];
+        if (!len) continue;
+        int c = next[len]++, r = 0;
+        for (int b = 0; b < len; b++, c >>= 1) r = (r << 1) | (c & 1);
+        codes[i] = r;
+    }
+}
+
+/*
+ * Bits needed by the block's symbols with the given lengths.
+ */
+static unsigned long data_bits(const deflate_t *s, const uint8_t *lit_lens, const uint8_t *dist_lens) {
+    unsigned long bits = 0;
+    for (int i = 0; i < LIT_CODES; i++) {
+        bits += (unsigned long)s->lit_freq[i] * (lit_lens[i] + (i > 256 ? length_extra[i - 257] : 0));
+    }
+    for (int i = 0; i < DIST_CODES; i++) {
+        bits += (unsigned long)s->dist_freq[i] * (dist_lens[i] + dist_extra[i]);
+    }
+    return bits;
+}
+
+/*
+ * Run-length encode the code lengths with symbols 16 (repeat the
+ * previous 3-6 times), 17 (3-10 zeros) and 18 (11-138 zeros).
+ * Each item is symbol | extra << 5. Returns the item count.
+ */
+static int rle_lengths(const uint8_t *lens, int n, uint16_t *items) {
+    int count = 0;
+    for (int i = 0; i < n;) {
+        int v = lens[i];
+        int run = 1;
+        while (i + run < n && lens[i + run] == v) run++;
+        i += run;
+
+        if (v == 0) {
+            while (run >= 11) {
+                int r = run < 138 ? run : 138;
+                items[count++] = 18 | ((r - 11) << 5);
+                run -= r;
+            }
+            if (run >= 3) {
+                items[count++] = 17 | ((run - 3) << 5);
+                run = 0;
+            }
+        } else {
+            items[count++] = v;
+            run--;
+            while (run >= 3) {
+                int r = run < 6 ? run : 6;
+                items[count++] = 16 | ((r - 3) << 5);
+                run -= r;
+            }
+        }
+        while (run-- > 0) items[count++] = v;
+    }
+    return count;
+}
+
+static void write_symbols(deflate_t *s, const uint8_t *lit_lens, const uint16_t *lit_codes,
+                          const uint8_t *dist_lens, const uint16_t *dist_codes) {
+    for (int i = 0; i < s->sym_count; i++) {
+        int dist = s->sym_dist[i];
+        if (!dist) {
+            int lit = s->sym_lit[i];
+            put_bits(s, lit_codes[lit], lit_lens[lit]);
+            continue;
+        }
+        int len = s->sym_lit[i] + MIN_MATCH;
+        int lc = length_code[len];
+        put_bits(s, lit_codes[257 + lc], lit_lens[257 + lc]);
+        put_bits(s, len - length_base[lc], length_extra[lc]);
+        int dc = dist_code(dist);
+        put_bits(s, dist_codes[dc], dist_lens[dc]);
+        put_bits(s, dist - dist_base[dc], dist_extra[dc]);
+    }
+    put_bits(s, lit_codes[256], lit_lens[256]);
+}
+
+static void write_stored(deflate_t *s, int final) {
+    const unsigned char *p = s->window + s->block_start;
+    int left = s->strstart - s->block_start;
+    do {
+        int n = left < 65535 ? left : 65535;
+        left -= n;
+        put_bits(s, final && !left, 1);
+        put_bits(s, 0, 2);
+        align_byte(s);
+        put_bits(s, n, 16);
+        put_bits(s, ~n & 0xFFFF, 16);
+        while (n--) put_bits(s, *p++, 8);
+    } while (left > 0);
+}
+
+/*
+ * Write the buffered symbols as one block in the cheapest form.
+ */
+static void flush_block(deflate_t *s, int final) {
+    uint8_t lit_lens[LIT_CODES], dist_lens[DIST_CODES], cl_lens[CL_CODES];
+    uint16_t lit_codes[LIT_CODES], dist_codes[DIST_CODES], cl_codes[CL_CODES];
+    uint8_t all_lens[LIT_CODES + DIST_CODES];
+    uint16_t items[LIT_CODES + DIST_CODES];
+    unsigned int cl_freq[CL_CODES] = { 0 };
+
+    s->lit_freq[256] = 1;
+    // Keep every code at two symbols or more: single-code trees are
+    // rejected by some decoders
+    if (s->sym_count == 0) s->lit_freq[0]++;
+    int dists = 0;
+    for (int i = 0; i < DIST_CODES; i++) dists += s->dist_freq[i] != 0;
+    if (dists < 2) {
+        s->dist_freq[0] += !s->dist_freq[0];
+        s->dist_freq[1] += !s->dist_freq[1];
+    }
+
+    limited_lengths(s->lit_freq, LIT_CODES, 15, lit_lens);
+    limited_lengths(s->dist_freq, DIST_CODES, 15, dist_lens);
+
+    int hlit = LIT_CODES;
+    while (hlit > 257 && !lit_lens[hlit - 1]) hlit--;
+    int hdist = DIST_CODES;
+    while (hdist > 1 && !dist_lens[hdist - 1]) hdist--;
+    memcpy(all_lens, lit_lens, hlit);
+    memcpy(all_lens + hlit, dist_lens, hdist);
+    int item_count = rle_lengths(all_lens, hlit + hdist, items);
+    for (int i = 0; i < item_count; i++) cl_freq[items[i] & 31]++;
+    limited_lengths(cl_freq, CL_CODES, 7, cl_lens);
+    int hclen = CL_CODES;
+    while (hclen > 4 && !cl_lens[cl_order[hclen - 1]]) hclen--;
+
+    // Sizes of the three forms, in bits
+    unsigned long dynamic_bits = 3 + 14 + 3 * hclen + data_bits(s, lit_lens, dist_lens);
+    for (int i = 0; i < item_count; i++) {
+        int sym = items[i] & 31;
+        dynamic_bits += cl_lens[sym] + (sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0);
+    }
+    uint8_t fixed_lit[LIT_CODES], fixed_dist[DIST_CODES];
+    for (int i = 0; i < LIT_CODES; i++) fixed_lit[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    memset(fixed_dist, 5, sizeof(fixed_dist));
+    unsigned long fixed_bits = 3 + data_bits(s, fixed_lit, fixed_dist);
+    unsigned long raw = s->strstart - s->block_start;
+    unsigned long stored_bits = (raw / 65535 + 1) * (3 + 7 + 32) + raw * 8;
+
+    if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits) {
+        write_stored(s, final);
+    } else if (fixed_bits <= dynamic_bits) {
+        put_bits(s, final, 1);
+        put_bits(s, 1, 2);
+        canonical_codes(fixed_lit, LIT_CODES, lit_codes);
+        canonical_codes(fixed_dist, DIST_CODES, dist_codes);
+        write_symbols(s, fixed_lit, lit_codes, fixed_dist, dist_codes);
+    } else {
+        put_bits(s, final, 1);
+        put_bits(s, 2, 2);
+        put_bits(s, hlit - 257, 5);
+        put_bits(s, hdist - 1, 5);
+        put_bits(s, hclen - 4, 4);
+        for (int i = 0; i < hclen; i++) put_bits(s, cl_lens[cl_order[i]], 3);
+        canonical_codes(cl_lens, CL_CODES, cl_codes);
+        for (int i = 0; i < item_count; i++) {
+            int sym = items[i] & 31, extra = items[i] >> 5;
+            put_bits(s, cl_codes[sym], cl_lens[sym]);
+            if (sym == 16) put_bits(s, extra, 2);
+            else if (sym == 17) put_bits(s, extra, 3);
+            else if (sym == 18) put_bits(s, extra, 7);
+        }
+        canonical_codes(lit_lens, LIT_CODES, lit_codes);
+        canonical_codes(dist_lens, DIST_CODES, dist_codes);
+        write_symbols(s, lit_lens, lit_codes, dist_lens, dist_codes);
+    }
+
+    memset(s->lit_freq, 0, sizeof(s->lit_freq));
+    memset(s->dist_freq, 0, sizeof(s->dist_freq));
+    s->sym_count = 0;
+    s->block_start = s->strstart;
+}
+
+/*
+ * Matching
+ */
+static int hash_at(const deflate_t *s, int pos) {
+    const unsigned char *p = s->window + pos;
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & HASH_MASK;
+}
+
+static int insert_hash(deflate_t *s, int pos) {
+    int h = hash_at(s, pos);
+    int candidate = s->head[h];
+    s->prev[pos & WMASK] = candidate;
+    s->head[h] = pos;
+    return candidate;
+}
+
+/*
+ * Longest match for the string at strstart along the hash chain
+ * starting at candidate. Returns its length (0 if under MIN_MATCH).
+ */
+static int longest_match(deflate_t *s, int candidate, int *dist) {
+    const unsigned char *scan = s->window + s->strstart;
+    int limit = s->strstart > MAX_DIST ? s->strstart - MAX_DIST : 0;
+    int max_len = s->lookahead < MAX_MATCH ? s->lookahead : MAX_MATCH;
+    int best = MIN_MATCH - 1;
+    int chain = DEFLATE_MAX_CHAIN;
+
+    while (candidate > limit && chain-- > 0) {
+        const unsigned char *m = s->window + candidate;
+        // Cheap rejection: the byte that would make this match longer
+        if (m[best] == scan[best] && m[0] == scan[0] && m[1] == scan[1]) {
+            int len = 2;
+            while (len < max_len && m[len] == scan[len]) len++;
+            if (len > best) {
+                best = len;
+                *dist = s->strstart - candidate;
+                if (len >= NICE_MATCH || len == max_len) break;
+            }
+        }
+        // Chain entries past the window were overwritten by newer positions
+        int next = s->prev[candidate & WMASK];
+        if (next >= candidate) break;
+        candidate = next;
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+/*
+ * Top up the lookahead, sliding the window down by 32 KB when the
+ * current position reaches the top (after ending the block, whose
+ * bytes would otherwise be lost).
+ */
+static void fill_window(deflate_t *s) {
+    while (s->lookahead < MIN_LOOKAHEAD && !s->eof && !s->error) {
+        if (s->strstart >= WSIZE + MAX_DIST) {
+            flush_block(s, 0);
+            memcpy(s->window, s->window + WSIZE, WSIZE);
+            s->strstart -= WSIZE;
+            s->block_start -= WSIZE;
+            for (int i = 0; i < HASH_SIZE; i++) s->head[i] = s->head[i] >= WSIZE ? s->head[i] - WSIZE : 0;
+            for (int i = 0; i < WSIZE; i++) s->prev[i] = s->prev[i] >= WSIZE ? s->prev[i] - WSIZE : 0;
+        }
+
+        int end = s->strstart + s->lookahead;
+        int n = s->read(s->read_user, s->window + end, 2 * WSIZE - end);
+        if (n < 0) s->error = DEFLATE_ERR_IO;
+        if (n <= 0) s->eof = 1;
+        else s->lookahead += n;
+    }
+}
+
+int deflate_stream(deflate_read_fn read, void *read_user, deflate_write_fn write, void *write_user) {
+    deflate_t *s = calloc(1, sizeof(deflate_t));
+    if (!s) return DEFLATE_ERR_MEM;
+    if (!length_code[MAX_MATCH]) build_code_tables();
+    s->read = read;
+    s->read_user = read_user;
+    s->write = write;
+    s->write_user = write_user;
+
+    while (!s->error) {
+        fill_window(s);
+        if (s->lookahead == 0) break;
+
+        int len = 0, dist = 0;
+        if (s->lookahead >= MIN_MATCH) len = longest_match(s, insert_hash(s, s->strstart), &dist);
+
+        if (len) {
+            s->sym_lit[s->sym_count] = len - MIN_MATCH;
+            s->sym_dist[s->sym_count++] = dist;
+            s->lit_freq[257 + length_code[len]]++;
+            s->dist_freq[dist_code(dist)]++;
+            // The positions inside the match still go into the chains
+            int end = s->strstart + s->lookahead;
+            for (int i = 1; i < len; i++) {
+                if (s->strstart + i + MIN_MATCH <= end) insert_hash(s, s->strstart + i);
+            }
+            s->strstart += len;
+            s->lookahead -= len;
+        } else {
+            s->sym_lit[s->sym_count] = s->window[s->strstart];
+            s->sym_dist[s->sym_count++] = 0;
+            s->lit_freq[s->window[s->strstart]]++;
+            s->strstart++;
+            s->lookahead--;
+        }
+        if (s->sym_count == SYM_BUF) flush_block(s, 0);
+    }
+
+    if (!s->error) {
+        flush_block(s, 1);
+        align_byte(s);
+        flush_out(s);
+    }
+    int result = s->error;
+    free(s);
+    return result;
+}
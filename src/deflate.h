@@ -0,0 +1,20 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+// Supply up to size bytes of input. Returns the count, 0 at the end
+// of the input, -1 on a read error.
+typedef int (*deflate_read_fn)(void *user, unsigned char *buf, int size);
+
+// Consume size bytes of compressed output. Returns 0, or -1 to abort.
+typedef int (*deflate_write_fn)(void *user, const unsigned char *buf, int size);
+
+#define DEFLATE_OK 0
+#define DEFLATE_ERR_IO -2 // A callback failed
+#define DEFLATE_ERR_MEM -3
+
+// Compress everything read into one raw DEFLATE stream (no zlib or
+// gzip header). Memory use is fixed (about 210 KB) whatever the
+// input size.
+int deflate_stream(deflate_read_fn read, void *read_user, deflate_write_fn write, void *write_user);
+
+#endif
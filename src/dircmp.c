@@ -0,0 +1,432 @@
+/*
+ * Folder compare and sync
+ *
+ * Both trees are walked once into flat, pre-ordered entry arrays
+ * (relative path, size, type) with one pool of names each, and each
+ * tree gets an open-addressing hash map on the relative path. Every
+ * entry of the left tree is then looked up in the right one: a
+ * missing partner makes it only-left (and everything under a missing
+ * folder is "implied" by it), a different type or size makes it
+ * differ, and only files of equal size are read. Those are streamed
+ * side by side in chunks and compared as they go, which reads no
+ * more than checksumming both would and stops at the first
+ * difference.
+ *
+ * A sync toward one side deletes what exists only there (a whole
+ * folder at once), then walks the source in pre-order creating
+ * folders and copying new or changed files, so nothing that is
+ * already the same is touched.
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "dircmp.h"
+#include "fs.h"
+#include "ui.h"
+#include "input.h"
+
+#define COMPARE_CHUNK 4096
+
+static int add_entry(dircmp_tree_t *t, const char *name, const struct stat *st, uint8_t state) {
+    if (t->count >= t->capacity) {
+        int new_capacity = t->capacity ? t->capacity * 2 : 64;
+        dircmp_entry_t *entries = realloc(t->entries, new_capacity * sizeof(dircmp_entry_t));
+        if (!entries) return DIRCMP_ERR_MEM;
+        t->entries = entries;
+        t->capacity = new_capacity;
+    }
+    uint32_t len = strlen(name) + 1;
+    if (t->names_used + len > t->names_capacity) {
+        uint32_t new_capacity = t->names_capacity ? t->names_capacity * 2 : 4096;
+        while (new_capacity < t->names_used + len) new_capacity *= 2;
+        char *names = realloc(t->names, new_capacity);
+        if (!names) return DIRCMP_ERR_MEM;
+        t->names = names;
+        t->names_capacity = new_capacity;
+    }
+    memcpy(t->names + t->names_used, name, len);
+
+    dircmp_entry_t *e = &t->entries[t->count++];
+    e->name = t->names_used;
+    e->size = S_ISDIR(st->st_mode) ? 0 : (uint32_t)st->st_size;
+    e->is_dir = S_ISDIR(st->st_mode);
+    e->state = state;
+    e->implied = 0;
+    t->names_used += len;
+    return 0;
+}
+
+/*
+ * Add everything under path, named relative to the tree root
+ * (rel is "" for the root itself). A folder comes before its
+ * contents.
+ */
+static int walk(dircmp_tree_t *t, const char *path, const char *rel, uint8_t state) {
+    DIR *d = opendir(path);
+    if (!d) return DIRCMP_ERR_READ;
+
+    int res = 0;
+    struct dirent *dir;
+    while (res == 0 && (dir = readdir(d)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
+
+        char child[1024];
+        char child_rel[1024];
+        snprintf(child, sizeof(child), "%s/%s", strcmp(path, "/") == 0 ? "" : path, dir->d_name);
+        if (rel[0]) snprintf(child_rel, sizeof(child_rel), "%s/%s", rel, dir->d_name);
+        else snprintf(child_rel, sizeof(child_rel), "%s", dir->d_name);
+
+        struct stat st;
+        if (stat(child, &st) != 0) continue;
+        res = add_entry(t, child_rel, &st, state);
+        if (res == 0 && S_ISDIR(st.st_mode)) res = walk(t, child, child_rel, state);
+    }
+    closedir(d);
+    return res;
+}
+
+// FNV-1a
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int build_map(dircmp_tree_t *t) {
+    uint32_t size = 16;
+    while (size < (uint32_t)t->count * 2) size *= 2;
+    t->slots = malloc(size * sizeof(int));
+    if (!t->slots) return DIRCMP_ERR_MEM;
+    t->mask = size - 1;
+    for (uint32_t i = 0; i < size; i++) t->slots[i] = -1;
+
+    for (int i = 0; i < t->count; i++) {
+        uint32_t h = hash_name(t->names + t->entries[i].name) & t->mask;
+        while (t->slots[h] >= 0) h = (h + 1) & t->mask;
+        t->slots[h] = i;
+    }
+    return 0;
+}
+
+static int map_find(const dircmp_tree_t *t, const char *name) {
+    uint32_t h = hash_name(name) & t->mask;
+    while (t->slots[h] >= 0) {
+        int i = t->slots[h];
+        if (strcmp(t->names + t->entries[i].name, name) == 0) return i;
+        h = (h + 1) & t->mask;
+    }
+    return -1;
+}
+
+/*
+ * Mark entry i implied if its parent folder exists on this side only,
+ * or is a file on the other side (the only way a folder differs).
+ * The parent comes earlier in pre-order, so its state is final.
+ */
+static void mark_implied(dircmp_tree_t *t, int i, uint8_t only) {
+    char parent[1024];
+    snprintf(parent, sizeof(parent), "%s", t->names + t->entries[i].name);
+    char *slash = strrchr(parent, '/');
+    if (!slash) return;
+    *slash = '\0';
+    int p = map_find(t, parent);
+    if (p >= 0 && (t->entries[p].state == only || t->entries[p].state == DIRCMP_DIFFERS)) {
+        t->entries[i].implied = 1;
+    }
+}
+
+/*
+ * Returns 1 if the files differ (or either cannot be read), 0 if
+ * they are the same. done is advanced by the bytes compared.
+ */
+static int files_differ(const char *a, const char *b, unsigned long *done, unsigned long total, int *last) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int differ = !fa || !fb;
+    unsigned char buf_a[COMPARE_CHUNK];
+    unsigned char buf_b[COMPARE_CHUNK];
+
+    while (!differ) {
+        size_t na = fread(buf_a, 1, sizeof(buf_a), fa);
+        size_t nb = fread(buf_b, 1, sizeof(buf_b), fb);
+        if (na != nb || memcmp(buf_a, buf_b, na) != 0) differ = 1;
+        if (na == 0) break;
+
+        *done += na;
+        int percent = total ? (int)((unsigned long long)*done * 100 / total) : 100;
+        if (percent != *last) {
+            *last = percent;
+            ui_draw_progress("Comparing", percent);
+        }
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return differ;
+}
+
+static void path_join(char *out, size_t size, const char *root, const char *rel) {
+    if (strcmp(root, "/") == 0) snprintf(out, size, "/%s", rel);
+    else snprintf(out, size, "%s/%s", root, rel);
+}
+
+// inner is outer itself or a folder somewhere below it
+static int is_within(const char *inner, const char *outer) {
+    size_t len = strlen(outer);
+    if (strcmp(outer, "/") == 0) return 1;
+    return strncmp(inner, outer, len) == 0 && (inner[len] == '\0' || inner[len] == '/');
+}
+
+int dircmp_run(const char *left_path, const char *right_path, dircmp_t *cmp) {
+    memset(cmp, 0, sizeof(*cmp));
+    if (is_within(left_path, right_path) || is_within(right_path, left_path)) return DIRCMP_ERR_NESTED;
+    snprintf(cmp->left_path, sizeof(cmp->left_path), "%s", left_path);
+    snprintf(cmp->right_path, sizeof(cmp->right_path), "%s", right_path);
+    dircmp_tree_t *l = &cmp->left;
+    dircmp_tree_t *r = &cmp->right;
+
+    ui_draw_modal("Reading folders...");
+    int res = walk(l, left_path, "", DIRCMP_ONLY_LEFT);
+    if (res == 0) res = walk(r, right_path, "", DIRCMP_ONLY_RIGHT);
+    if (res == 0) res = build_map(l);
+    if (res == 0) res = build_map(r);
+    if (res != 0) {
+        dircmp_free(cmp);
+        return res;
+    }
+
+    // Match by path; type and size settle most pairs without reading
+    unsigned long total = 0;
+    for (int i = 0; i < l->count; i++) {
+        dircmp_entry_t *e = &l->entries[i];
+        int j = map_find(r, l->names + e->name);
+        if (j < 0) {
+            mark_implied(l, i, DIRCMP_ONLY_LEFT);
+            continue;
+        }
+        dircmp_entry_t *o = &r->entries[j];
+        if (e->is_dir != o->is_dir || e->size != o->size) {
+            e->state = o->state = DIRCMP_DIFFERS;
+        } else {
+            e->state = o->state = DIRCMP_SAME;
+            total += e->size;
+        }
+    }
+    for (int i = 0; i < r->count; i++) {
+        if (r->entries[i].state == DIRCMP_ONLY_RIGHT) mark_implied(r, i, DIRCMP_ONLY_RIGHT);
+    }
+
+    // Same-size file pairs: compare the contents
+    unsigned long done = 0;
+    int last = -1;
+    for (int i = 0; i < l->count; i++) {
+        dircmp_entry_t *e = &l->entries[i];
+        if (e->state != DIRCMP_SAME || e->is_dir) continue;
+        const char *name = l->names + e->name;
+        char a[1024];
+        char b[1024];
+        path_join(a, sizeof(a), left_path, name);
+        path_join(b, sizeof(b), right_path, name);
+        if (files_differ(a, b, &done, total, &last)) {
+            e->state = DIRCMP_DIFFERS;
+            r->entries[map_find(r, name)].state = DIRCMP_DIFFERS;
+        }
+    }
+
+    for (int i = 0; i < l->count; i++) {
+        if (!l->entries[i].implied) cmp->counts[l->entries[i].state]++;
+    }
+    for (int i = 0; i < r->count; i++) {
+        if (!r->entries[i].implied && r->entries[i].state == DIRCMP_ONLY_RIGHT) cmp->counts[DIRCMP_ONLY_RIGHT]++;
+    }
+    return 0;
+}
+
+static void free_tree(dircmp_tree_t *t) {
+    free(t->entries);
+    free(t->names);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+void dircmp_free(dircmp_t *cmp) {
+    free_tree(&cmp->left);
+    free_tree(&cmp->right);
+}
+
+/*
+ * Walk the sync plan: deletes in the target, then folders and files
+ * from the source in pre-order. With execute 0 the operations are
+ * only counted. Returns the count, failures go to *failed.
+ */
+static int sync_plan(dircmp_t *cmp, int right_to_left, int execute, int *failed) {
+    dircmp_tree_t *src = right_to_left ? &cmp->right : &cmp->left;
+    dircmp_tree_t *dst = right_to_left ? &cmp->left : &cmp->right;
+    const char *src_root = right_to_left ? cmp->right_path : cmp->left_path;
+    const char *dst_root = right_to_left ? cmp->left_path : cmp->right_path;
+    uint8_t only_src = right_to_left ? DIRCMP_ONLY_RIGHT : DIRCMP_ONLY_LEFT;
+    uint8_t only_dst = right_to_left ? DIRCMP_ONLY_LEFT : DIRCMP_ONLY_RIGHT;
+    int total = execute ? sync_plan(cmp, right_to_left, 0, NULL) : 0;
+    int ops = 0;
+    char path[1024];
+    char from[1024];
+
+    // Whatever exists only in the target goes, as does a file that
+    // became a folder (or the reverse)
+    for (int i = 0; i < dst->count; i++) {
+        dircmp_entry_t *e = &dst->entries[i];
+        const char *name = dst->names + e->name;
+        if (e->implied) continue;
+        if (e->state == DIRCMP_DIFFERS) {
+            if (src->entries[map_find(src, name)].is_dir == e->is_dir) continue;
+        } else if (e->state != only_dst) {
+            continue;
+        }
+        ops++;
+        if (!execute) continue;
+        path_join(path, sizeof(path), dst_root, name);
+        if ((e->is_dir ? fs_delete_recursive(path) : remove(path)) != 0) (*failed)++;
+        ui_draw_progress("Syncing", ops * 100 / total);
+    }
+
+    // Pre-order: every folder is made before its contents are copied
+    for (int i = 0; i < src->count; i++) {
+        dircmp_entry_t *e = &src->entries[i];
+        if (e->state != only_src && e->state != DIRCMP_DIFFERS) continue;
+        ops++;
+        if (!execute) continue;
+        const char *name = src->names + e->name;
+        path_join(path, sizeof(path), dst_root, name);
+        if (e->is_dir) {
+            if (mkdir(path, 0755) != 0) (*failed)++;
+        } else {
+            path_join(from, sizeof(from), src_root, name);
+            if (fs_copy_file(from, path) != 0) (*failed)++;
+        }
+        ui_draw_progress("Syncing", ops * 100 / total);
+    }
+    return ops;
+}
+
+int dircmp_sync(dircmp_t *cmp, int right_to_left) {
+    int failed = 0;
+    sync_plan(cmp, right_to_left, 1, &failed);
+    return failed;
+}
+
+static int compare_shown(const void *a, const void *b) {
+    // Past the state marker, in path order
+    return strcasecmp(((const file_entry_t *)a)->name + 2, ((const file_entry_t *)b)->name + 2);
+}
+
+/*
+ * The differences as a list: "<" only left, ">" only right, "!"
+ * differs, with implied entries left out. Returns 0 or -1.
+ */
+static int build_list(const dircmp_t *cmp, int from_right, file_list_t *list) {
+    static const char markers[4] = { '=', '<', '>', '!' };
+    int n = cmp->counts[DIRCMP_ONLY_LEFT] + cmp->counts[DIRCMP_ONLY_RIGHT] + cmp->counts[DIRCMP_DIFFERS];
+    fs_free(list);
+    list->entries = malloc((n ? n : 1) * sizeof(file_entry_t));
+    if (!list->entries) return -1;
+
+    const dircmp_tree_t *trees[2] = { &cmp->left, &cmp->right };
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < trees[t]->count; i++) {
+            const dircmp_entry_t *e = &trees[t]->entries[i];
+            if (e->implied || e->state == DIRCMP_SAME) continue;
+            if (t == 1 && e->state != DIRCMP_ONLY_RIGHT) continue; // Pairs are listed once
+            file_entry_t *f = &list->entries[list->count++];
+            snprintf(f->name, sizeof(f->name), "%c %s", markers[e->state], trees[t]->names + e->name);
+            f->is_dir = e->is_dir;
+            f->size = e->size;
+            f->mtime = 0;
+        }
+    }
+    qsort(list->entries, list->count, sizeof(file_entry_t), compare_shown);
+
+    snprintf(list->path, sizeof(list->path), "<%d >%d !%d =%d  S:Sync %s",
+             cmp->counts[DIRCMP_ONLY_LEFT], cmp->counts[DIRCMP_ONLY_RIGHT],
+             cmp->counts[DIRCMP_DIFFERS], cmp->counts[DIRCMP_SAME], from_right ? "<-" : "->");
+    return 0;
+}
+
+static void show_message(const char *msg) {
+    ui_draw_modal(msg);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
+int dircmp_view(const char *left_path, const char *right_path, int from_right) {
+    dircmp_t cmp;
+    file_list_t list = {0};
+    int changed = 0;
+
+    int res = dircmp_run(left_path, right_path, &cmp);
+    if (res == 0 && build_list(&cmp, from_right, &list) != 0) res = DIRCMP_ERR_MEM;
+    if (res != 0) {
+        dircmp_free(&cmp);
+        show_message(res == DIRCMP_ERR_MEM ? "Out of memory" :
+                     res == DIRCMP_ERR_NESTED ? "One folder is inside the other" : "Cannot read folder");
+        return 0;
+    }
+
+    int selection = 0;
+    int scroll_offset = 0;
+    int full_redraw = 1;
+
+    while (1) {
+        if (full_redraw) ui_draw_list(&list, selection, scroll_offset);
+        full_redraw = 1;
+
+        int c = input_get_key();
+        int nav = ui_list_key(&list, c, &selection, &scroll_offset);
+
+        if (nav) {
+            full_redraw = nav == 2;
+        } else if (c == 's' || c == 'S') {
+            int ops = sync_plan(&cmp, from_right, 0, NULL);
+            if (ops == 0) {
+                show_message("Folders already match");
+                continue;
+            }
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Sync %d change%s %s?", ops, ops == 1 ? "" : "s",
+                     from_right ? "to the left" : "to the right");
+            if (!ui_get_confirmation(msg)) continue;
+
+            ui_draw_progress("Syncing", 0);
+            int failed = dircmp_sync(&cmp, from_right);
+            changed = 1;
+            if (failed) {
+                snprintf(msg, sizeof(msg), "%d operation%s failed", failed, failed == 1 ? "" : "s");
+                show_message(msg);
+            }
+
+            // Show what is left (nothing, unless something failed)
+            dircmp_free(&cmp);
+            res = dircmp_run(left_path, right_path, &cmp);
+            if (res != 0 || build_list(&cmp, from_right, &list) != 0) {
+                show_message("Cannot read folder");
+                break;
+            }
+            selection = 0;
+            scroll_offset = 0;
+        } else if (c == NIO_KEY_ESC || c == NIO_KEY_LEFT || c == 'q') {
+            break;
+        } else {
+            full_redraw = 0;
+        }
+    }
+
+    fs_free(&list);
+    dircmp_free(&cmp);
+    return changed;
+}
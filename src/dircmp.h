@@ -0,0 +1,57 @@
+#ifndef DIRCMP_H
+#define DIRCMP_H
+
+#include <stdint.h>
+
+#define DIRCMP_SAME 0
+#define DIRCMP_ONLY_LEFT 1
+#define DIRCMP_ONLY_RIGHT 2
+#define DIRCMP_DIFFERS 3
+
+// One file or folder of a tree, named by its path relative to the root
+typedef struct {
+    uint32_t name;   // Offset of the NUL-terminated path in names
+    uint32_t size;
+    uint8_t is_dir;
+    uint8_t state;   // DIRCMP_
+    uint8_t implied; // Inside a folder that exists on one side only
+} dircmp_entry_t;
+
+typedef struct {
+    dircmp_entry_t *entries; // Pre-order: a folder before its contents
+    int count;
+    int capacity;
+    char *names;
+    uint32_t names_used;
+    uint32_t names_capacity;
+    int *slots;              // Hash map on the relative path, -1 = empty
+    uint32_t mask;
+} dircmp_tree_t;
+
+typedef struct {
+    char left_path[1024];
+    char right_path[1024];
+    dircmp_tree_t left, right;
+    int counts[4]; // Entries shown per state (not counting implied ones)
+} dircmp_t;
+
+#define DIRCMP_ERR_READ -1
+#define DIRCMP_ERR_MEM -2
+#define DIRCMP_ERR_NESTED -3 // One folder is the other, or inside it
+
+// Walk both trees and classify every entry. Returns 0 or a
+// DIRCMP_ERR_ code. Nested folders are refused: syncing one onto
+// the other would delete or copy into itself.
+int dircmp_run(const char *left_path, const char *right_path, dircmp_t *cmp);
+void dircmp_free(dircmp_t *cmp);
+
+// Make the right tree a copy of the left one (or the reverse), with
+// only the copies and deletes the comparison calls for. Returns the
+// number of operations that failed.
+int dircmp_sync(dircmp_t *cmp, int right_to_left);
+
+// Compare two folders and show the differences; S syncs toward the
+// other side of from_right. Returns 1 if anything was changed.
+int dircmp_view(const char *left_path, const char *right_path, int from_right);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * Duplicate finder
+ *
+ * Files are narrowed down in stages, each cheaper than the next:
+ *
+ *   1. Size. A first walk only counts how many files have each size
+ *      (a hash map of size -> count); a second walk records the path
+ *      of a file only if its size is shared. Memory grows with the
+ *      candidates, not with every file under the root.
+ *   2. A CRC-32 of the first and last 4 KB, for candidates still
+ *      sharing their size with another (files of up to 8 KB go
+ *      straight to stage 3, which reads no more).
+ *   3. SHA-256 of the whole file, only for those whose size and
+ *      samples both still match another file's.
+ *
+ * Each stage sorts the candidates so that equal keys are
+ * neighbours, and only runs of two or more go on to the next.
+ * Empty files are ignored: they are all "the same".
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "dupes.h"
+#include "checksum.h"
+#include "fs.h"
+#include "ui.h"
+#include "input.h"
+
+#define SAMPLE_SIZE 4096
+#define HASH_CHUNK 32768
+#define MAX_REL_PATH 250 // Leaves room for the list's marker
+
+typedef struct {
+    unsigned int size;
+    unsigned int count;
+} size_slot_t;
+
+// Open addressing on the size; 0 marks a free slot (empty files are skipped)
+typedef struct {
+    size_slot_t *slots;
+    unsigned int mask;
+    unsigned int used;
+} size_map_t;
+
+static unsigned int size_hash(unsigned int size) {
+    unsigned int h = size * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static size_slot_t *size_slot(size_map_t *m, unsigned int size) {
+    unsigned int h = size_hash(size) & m->mask;
+    while (m->slots[h].size && m->slots[h].size != size) h = (h + 1) & m->mask;
+    return &m->slots[h];
+}
+
+static int size_map_add(size_map_t *m, unsigned int size) {
+    // Keep the load under half, rehashing into twice the slots
+    if (!m->slots || (m->used + 1) * 2 > m->mask + 1) {
+        unsigned int capacity = m->slots ? (m->mask + 1) * 2 : 1024;
+        size_map_t grown = { calloc(capacity, sizeof(size_slot_t)), capacity - 1, m->used };
+        if (!grown.slots) return -1;
+        for (unsigned int i = 0; m->slots && i <= m->mask; i++) {
+            if (m->slots[i].size) *size_slot(&grown, m->slots[i].size) = m->slots[i];
+        }
+        free(m->slots);
+        *m = grown;
+    }
+    size_slot_t *s = size_slot(m, size);
+    if (!s->size) {
+        s->size = size;
+        m->used++;
+    }
+    s->count++;
+    return 0;
+}
+
+static int add_file(dupe_set_t *set, const char *name, unsigned int size) {
+    if (set->count >= set->capacity) {
+        int new_capacity = set->capacity ? set->capacity * 2 : 64;
+        dupe_file_t *files = realloc(set->files, new_capacity * sizeof(dupe_file_t));
+        if (!files) return -1;
+        set->files = files;
+        set->capacity = new_capacity;
+    }
+    unsigned int len = strlen(name) + 1;
+    if (set->names_used + len > set->names_capacity) {
+        unsigned int new_capacity = set->names_capacity ? set->names_capacity * 2 : 4096;
+        while (new_capacity < set->names_used + len) new_capacity *= 2;
+        char *names = realloc(set->names, new_capacity);
+        if (!names) return -1;
+        set->names = names;
+        set->names_capacity = new_capacity;
+    }
+    memcpy(set->names + set->names_used, name, len);
+
+    dupe_file_t *f = &set->files[set->count++];
+    memset(f, 0, sizeof(*f));
+    f->name = set->names_used;
+    f->size = size;
+    set->names_used += len;
+    return 0;
+}
+
+/*
+ * Walk the tree under path. The first pass counts sizes into map,
+ * the second adds the files whose size is shared to set.
+ */
+static int walk(const char *path, const char *rel, int pass, size_map_t *map, dupe_set_t *set) {
+    DIR *d = opendir(path);
+    if (!d) return rel[0] ? 0 : -1; // An unreadable subfolder is skipped
+
+    int res = 0;
+    struct dirent *dir;
+    while (res == 0 && (dir = readdir(d)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
+
+        char child[1024];
+        char child_rel[1024];
+        snprintf(child, sizeof(child), "%s/%s", strcmp(path, "/") == 0 ? "" : path, dir->d_name);
+        if (rel[0]) snprintf(child_rel, sizeof(child_rel), "%s/%s", rel, dir->d_name);
+        else snprintf(child_rel, sizeof(child_rel), "%s", dir->d_name);
+        if (strlen(child_rel) > MAX_REL_PATH) continue;
+
+        struct stat st;
+        if (stat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            res = walk(child, child_rel, pass, map, set);
+        } else if (st.st_size > 0) {
+            if (pass == 0) res = size_map_add(map, st.st_size);
+            else if (size_slot(map, st.st_size)->count > 1) res = add_file(set, child_rel, st.st_size);
+        }
+    }
+    closedir(d);
+    return res;
+}
+
+static void path_join(char *out, size_t size, const char *root, const char *rel) {
+    if (strcmp(root, "/") == 0) snprintf(out, size, "/%s", rel);
+    else snprintf(out, size, "%s/%s", root, rel);
+}
+
+/*
+ * CRC-32 of the first and last SAMPLE_SIZE bytes.
+ */
+static int sample_file(const char *path, dupe_file_t *f) {
+    unsigned char buf[SAMPLE_SIZE];
+    FILE *in = fopen(path, "rb");
+    if (!in) return -1;
+    int ok = fread(buf, 1, SAMPLE_SIZE, in) == SAMPLE_SIZE;
+    f->partial = checksum_crc32(0, buf, SAMPLE_SIZE);
+    ok = ok && fseek(in, (long)f->size - SAMPLE_SIZE, SEEK_SET) == 0 &&
+         fread(buf, 1, SAMPLE_SIZE, in) == SAMPLE_SIZE;
+    f->partial = checksum_crc32(f->partial, buf, SAMPLE_SIZE);
+    fclose(in);
+    return ok ? 0 : -1;
+}
+
+static int hash_file(const char *path, dupe_file_t *f, unsigned char *buf) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return -1;
+    sha256_t sha;
+    sha256_init(&sha);
+    size_t n;
+    while ((n = fread(buf, 1, HASH_CHUNK, in)) > 0) sha256_update(&sha, buf, n);
+    int failed = ferror(in);
+    fclose(in);
+
+    unsigned char digest[32];
+    sha256_final(&sha, digest);
+    memcpy(f->full, digest, sizeof(f->full));
+    f->hashed = 1;
+    return failed ? -1 : 0;
+}
+
+// qsort has no context argument: the pool the comparators read names from
+static const char *sort_names;
+
+static int compare_size(const void *a, const void *b) {
+    const dupe_file_t *fa = (const dupe_file_t *)a;
+    const dupe_file_t *fb = (const dupe_file_t *)b;
+    if (fa->size != fb->size) return fa->size > fb->size ? -1 : 1; // Largest first
+    if (fa->partial != fb->partial) return fa->partial < fb->partial ? -1 : 1;
+    return memcmp(fa->full, fb->full, sizeof(fa->full));
+}
+
+// Within a group, the file to keep first: not a " - Copy", then the shortest path
+static int compare_group(const void *a, const void *b) {
+    int c = compare_size(a, b);
+    if (c) return c;
+    const char *na = sort_names + ((const dupe_file_t *)a)->name;
+    const char *nb = sort_names + ((const dupe_file_t *)b)->name;
+    int copy_a = strstr(na, " - Copy") != NULL;
+    int copy_b = strstr(nb, " - Copy") != NULL;
+    if (copy_a != copy_b) return copy_a - copy_b;
+    int la = strlen(na);
+    int lb = strlen(nb);
+    if (la != lb) return la - lb;
+    return strcmp(na, nb);
+}
+
+int dupes_same(const dupe_file_t *a, const dupe_file_t *b) {
+    return a->hashed && b->hashed && compare_size(a, b) == 0;
+}
+
+/*
+ * Sort by the keys so far and keep only files that equal a neighbour
+ * (and were read without error).
+ */
+static void keep_runs(dupe_set_t *set, int need_hash) {
+    qsort(set->files, set->count, sizeof(dupe_file_t), compare_size);
+    int kept = 0;
+    for (int i = 0; i < set->count; i++) {
+        dupe_file_t *f = &set->files[i];
+        int twin = (i > 0 && compare_size(f, f - 1) == 0 && !f[-1].failed) ||
+                   (i + 1 < set->count && compare_size(f, f + 1) == 0 && !f[1].failed);
+        if (f->failed || !twin || (need_hash && !f->hashed)) continue;
+        set->files[kept++] = *f;
+    }
+    set->count = kept;
+}
+
+static void stage_progress(const char *label, int done, int total, int *last) {
+    int percent = total ? done * 100 / total : 100;
+    if (percent == *last) return;
+    *last = percent;
+    ui_draw_progress(label, percent);
+}
+
+int dupes_find(const char *root, dupe_set_t *set) {
+    memset(set, 0, sizeof(*set));
+    size_map_t map = { NULL, 0, 0 };
+    char path[1024];
+
+    ui_draw_modal("Reading folders...");
+    int res = walk(root, "", 0, &map, set);
+    if (res == 0 && map.slots) res = walk(root, "", 1, &map, set);
+    free(map.slots);
+    if (res != 0) {
+        dupes_free(set);
+        return -1;
+    }
+
+    // Samples for the larger files; small ones are hashed whole
+    unsigned char *buf = malloc(HASH_CHUNK);
+    if (!buf) {
+        dupes_free(set);
+        return -1;
+    }
+    int last = -1;
+    for (int i = 0; i < set->count; i++) {
+        dupe_file_t *f = &set->files[i];
+        path_join(path, sizeof(path), root, set->names + f->name);
+        if (f->size <= 2 * SAMPLE_SIZE) f->failed = hash_file(path, f, buf) != 0;
+        else f->failed = sample_file(path, f) != 0;
+        stage_progress("Sampling", i + 1, set->count, &last);
+    }
+    keep_runs(set, 0);
+
+    // Full hashes where size and samples still match
+    last = -1;
+    for (int i = 0; i < set->count; i++) {
+        dupe_file_t *f = &set->files[i];
+        if (!f->hashed) {
+            path_join(path, sizeof(path), root, set->names + f->name);
+            f->failed = hash_file(path, f, buf) != 0;
+        }
+        stage_progress("Hashing", i + 1, set->count, &last);
+    }
+    free(buf);
+    keep_runs(set, 1);
+
+    sort_names = set->names;
+    qsort(set->files, set->count, sizeof(dupe_file_t), compare_group);
+    return 0;
+}
+
+void dupes_free(dupe_set_t *set) {
+    free(set->files);
+    free(set->names);
+    memset(set, 0, sizeof(*set));
+}
+
+static void show_message(const char *msg) {
+    ui_draw_modal(msg);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
+int dupes_view(const char *root) {
+    dupe_set_t set;
+    if (dupes_find(root, &set) != 0) {
+        show_message("Cannot search this folder");
+        return 0;
+    }
+    if (set.count == 0) {
+        dupes_free(&set);
+        show_message("No duplicates found");
+        return 0;
+    }
+
+    // "* " marks the file each group keeps, "- " the copies
+    file_list_t list = {0};
+    list.entries = malloc(set.count * sizeof(file_entry_t));
+    if (!list.entries) {
+        dupes_free(&set);
+        show_message("Out of memory");
+        return 0;
+    }
+    int groups = 0;
+    int copies = 0;
+    unsigned long wasted = 0;
+    for (int i = 0; i < set.count; i++) {
+        const dupe_file_t *f = &set.files[i];
+        int first = i == 0 || !dupes_same(f, f - 1);
+        file_entry_t *e = &list.entries[list.count++];
+        snprintf(e->name, sizeof(e->name), "%c %s", first ? '*' : '-', set.names + f->name);
+        e->is_dir = 0;
+        e->size = f->size;
+        e->mtime = 0;
+        if (first) {
+            groups++;
+        } else {
+            copies++;
+            wasted += f->size;
+        }
+    }
+    dupes_free(&set);
+    snprintf(list.path, sizeof(list.path), "%d groups, %lu KB in copies  D:Delete", groups, wasted / 1024);
+
+    int selection = 0;
+    int scroll_offset = 0;
+    int full_redraw = 1;
+    int deleted = 0;
+
+    while (1) {
+        if (full_redraw) ui_draw_list(&list, selection, scroll_offset);
+        full_redraw = 1;
+
+        int c = input_get_key();
+        int nav = ui_list_key(&list, c, &selection, &scroll_offset);
+
+        if (nav) {
+            full_redraw = nav == 2;
+        } else if (c == 'd' || c == 'D') {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Delete %d copies (%lu KB)?", copies, wasted / 1024);
+            if (!ui_get_confirmation(msg)) continue;
+
+            int failed = 0;
+            int done = 0;
+            int last = -1;
+            char path[1024];
+            for (int i = 0; i < list.count; i++) {
+                if (list.entries[i].name[0] != '-') continue;
+                path_join(path, sizeof(path), root, list.entries[i].name + 2);
+                if (remove(path) != 0) failed++;
+                else deleted++;
+                stage_progress("Deleting", ++done, copies, &last);
+            }
+            if (failed) snprintf(msg, sizeof(msg), "Deleted %d, %d failed", deleted, failed);
+            else snprintf(msg, sizeof(msg), "Deleted %d copies", deleted);
+            show_message(msg);
+            break;
+        } else if (c == NIO_KEY_ESC || c == NIO_KEY_LEFT || c == 'q') {
+            break;
+        } else {
+            full_redraw = 0;
+        }
+    }
+
+    fs_free(&list);
+    return deleted > 0;
+}
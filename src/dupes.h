@@ -0,0 +1,36 @@
+#ifndef DUPES_H
+#define DUPES_H
+
+// One file that has at least one twin of the same size, named
+// relative to the search root
+typedef struct {
+    unsigned int name;       // Offset of the path in the names pool
+    unsigned int size;
+    unsigned int partial;    // CRC-32 of the first and last 4 KB
+    unsigned char full[16];  // Leading half of the SHA-256 of the contents
+    unsigned char hashed;    // full is valid
+    unsigned char failed;    // Could not be read
+} dupe_file_t;
+
+typedef struct {
+    dupe_file_t *files;
+    int count;
+    int capacity;
+    char *names;
+    unsigned int names_used;
+    unsigned int names_capacity;
+} dupe_set_t;
+
+// Find files under root with identical contents. On return set holds
+// only duplicates, grouped: equal neighbours (dupes_same) are copies
+// of each other. Returns 0, or -1 when out of memory or root cannot
+// be read.
+int dupes_find(const char *root, dupe_set_t *set);
+void dupes_free(dupe_set_t *set);
+int dupes_same(const dupe_file_t *a, const dupe_file_t *b);
+
+// Show the duplicates under root in groups; D deletes all but one
+// file of every group. Returns 1 if anything was deleted.
+int dupes_view(const char *root);
+
+#endif
@@ -7,6 +7,11 @@
 * - Insert and delete
 * - Newline support
 * - Scroll support for long files
+* - Undo/redo (Ctrl+Z / Ctrl+Y)
+* - Incremental find, find next and replace all
+* - Syntax highlighting for C, Lua and Python
+* - Horizontal scrolling and optional soft wrap for long lines
+* - Line-level damage tracking: only changed rows are repainted
 * 
 * What it can't open:
 * - Binary files
@@ -21,20 +26,91 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "editor.h"
+#include "syntax.h"
 #include "input.h"
 #include "ui.h"
 
 
 /*
- * Buffer limits: 256 lines * 128 chars = 32KB max file size.
+ * Buffer limits: 256 lines of up to 127 chars (plus the terminator).
  * Fits comfortably in Nspire's limited RAM while allowing most scripts.
+ * A file is only edited if it fits whole: see editor_fits.
  */
 
 #define MAX_LINES 256
 #define MAX_LINE_LEN 128
 
 #define VISIBLE_ROWS 26
+#define VISIBLE_COLS 53     // 320px / 6px font
+#define HSCROLL_STEP 16     // Columns to jump when the cursor leaves the view
+
+/*
+ * Soft wrap breaks after a space in the second half of a row, or
+ * hard at VISIBLE_COLS, so a row is never shorter than half the
+ * screen and a full line needs at most this many rows.
+ */
+#define MAX_WRAP_ROWS 5
+
+// Damage range end meaning "every row from dmg_first down"
+#define DAMAGE_TO_END MAX_LINES
+
+/*
+ * Undo log limits. Text of all records shares one pool; the oldest
+ * steps are dropped when either limit is reached. Override at build
+ * time to trade memory for history depth.
+ */
+#ifndef UNDO_POOL_SIZE
+#define UNDO_POOL_SIZE (8 * 1024)
+#endif
+#ifndef UNDO_MAX_RECORDS
+#define UNDO_MAX_RECORDS 256
+#endif
+
+#define UNDO_INSERT 0
+#define UNDO_DELETE 1
+
+/*
+ * One buffer operation: `len` bytes of text (may contain '\n')
+ * inserted at or deleted from line/col. Records sharing a group
+ * are undone as a single step.
+ */
+typedef struct {
+    unsigned char type;
+    unsigned short line;
+    unsigned short col;
+    unsigned short group;
+    int text_off; // Offset of the text in the pool
+    int len;
+} undo_rec_t;
+
+typedef struct {
+    undo_rec_t recs[UNDO_MAX_RECORDS];
+    char pool[UNDO_POOL_SIZE];
+    int count;      // Records in the log
+    int pos;        // [0, pos) can be undone, [pos, count) redone
+    int pool_used;
+    unsigned short group;
+    int coalesce;   // Last record may absorb the next keystroke
+    int batch;      // Records share the current group
+} undo_log_t;
+
+/*
+ * Incremental search state. Matches of the current query are kept
+ * so that typing one more character only has to filter them.
+ */
+#define MAX_QUERY_LEN 32
+#define MAX_MATCHES 512
+
+typedef struct {
+    char query[MAX_QUERY_LEN];
+    int len;
+    unsigned short match_line[MAX_MATCHES];
+    unsigned char match_col[MAX_MATCHES];
+    int match_count;
+    int complete;   // 0 if the match list overflowed
+} search_state_t;
 
 typedef struct {
     char lines[MAX_LINES][MAX_LINE_LEN];
@@ -43,6 +119,22 @@ typedef struct {
     int cursor_col;
     int scroll_offset;
     int modified;
+    int mark_len;   // Highlighted match length at the cursor
+    int crlf;       // File used CRLF line endings
+    int lang;       // SYN_LANG_* for highlighting
+    unsigned char syn_state[MAX_LINES]; // Lexer state at the end of each line
+    int syn_valid;  // syn_state is computed for lines below this
+    int wrap;       // Soft wrap instead of horizontal scrolling
+    int hscroll;    // First visible column when not wrapping
+    unsigned char wrap_rows[MAX_LINES];                // Rows per line, 0 = not computed
+    unsigned char wrap_start[MAX_LINES][MAX_WRAP_ROWS]; // First column of each row
+    int dmg_all;    // Next draw repaints the whole screen
+    int dmg_first;  // Buffer lines [dmg_first, dmg_last] need repainting
+    int dmg_last;   // DAMAGE_TO_END also clears rows past the last line
+    int drawn_modified; // Modified marker currently on screen
+    int shift_rows; // Text area moves up this many rows before the next draw
+    undo_log_t undo;
+    search_state_t search;
 } editor_state_t;
 
 /*
@@ -53,56 +145,330 @@ typedef struct {
  * delete, and newline support. Scroll support for long files.
  *
  * Controls: Arrows=Navigate, Enter=Newline, Backspace=Delete,
- *           Ctrl/Menu=Save, Esc=Exit
+ *           Ctrl+Z=Undo, Ctrl+Y=Redo, Ctrl+F=Find, Ctrl+G=Find next,
+ *           Ctrl+R=Replace all, Ctrl+W=Wrap, Ctrl/Menu=Save, Esc=Exit
+ */
+
+// Colours for the SYN_* character classes
+static const unsigned char syntax_colors[] = {
+    NIO_COLOR_BLACK,     // SYN_DEFAULT
+    NIO_COLOR_BLUE,      // SYN_KEYWORD
+    NIO_COLOR_RED,       // SYN_STRING
+    NIO_COLOR_GREEN,     // SYN_COMMENT
+    NIO_COLOR_MAGENTA,   // SYN_NUMBER
+    NIO_COLOR_LIGHTBLACK // SYN_PREPROC
+};
+
+/*
+ * Mark buffer lines first..last for repainting on the next draw.
+ */
+static void editor_damage(editor_state_t *e, int first, int last) {
+    if (first < e->dmg_first) e->dmg_first = first;
+    if (last > e->dmg_last) e->dmg_last = last;
+}
+
+/*
+ * Make sure the end state of every line up to `last` is cached.
+ * States are computed lazily, only as far down as has been drawn.
+ */
+static void syntax_ensure(editor_state_t *e, int last) {
+    unsigned char cls[MAX_LINE_LEN];
+    for (; e->syn_valid <= last && e->syn_valid < e->line_count; e->syn_valid++) {
+        int l = e->syn_valid;
+        int in = (l > 0) ? e->syn_state[l - 1] : SYN_STATE_NORMAL;
+        e->syn_state[l] = syntax_lex_line(e->lang, e->lines[l], in, cls);
+    }
+}
+
+/*
+ * Lines first..last changed: re-lex them, then continue only until
+ * a line's end state matches the cached one again. A line past the
+ * edit is repainted when the state it starts in changed, even if it
+ * ends as before (typing an opening comment above its closing line).
+ */
+static void syntax_touch(editor_state_t *e, int first, int last) {
+    unsigned char cls[MAX_LINE_LEN];
+    int in_changed = 0; // The line's start state differs from the one it was lexed in
+    for (int l = first; l < e->syn_valid; l++) {
+        int in = (l > 0) ? e->syn_state[l - 1] : SYN_STATE_NORMAL;
+        int out = syntax_lex_line(e->lang, e->lines[l], in, cls);
+        int old = e->syn_state[l];
+        e->syn_state[l] = out;
+        if (l > last && in_changed) editor_damage(e, l, l);
+        if (l > last && out == old) return; // Converged: later lines start as before
+        in_changed = out != old;
+    }
+}
+
+/*
+ * Move the per-line caches along with a block of lines.
+ */
+static void line_info_move(editor_state_t *e, int dst, int src, int count) {
+    if (count <= 0) return;
+    memmove(&e->syn_state[dst], &e->syn_state[src], count);
+    memmove(&e->wrap_rows[dst], &e->wrap_rows[src], count);
+    memmove(e->wrap_start[dst], e->wrap_start[src], count * MAX_WRAP_ROWS);
+}
+
+/*
+ * Number of screen rows for a line (always 1 without wrap). Wrap
+ * positions are computed on first use and cached until the line
+ * is edited.
+ */
+static int editor_line_rows(editor_state_t *e, int l) {
+    if (!e->wrap) return 1;
+    if (e->wrap_rows[l] > 0) return e->wrap_rows[l];
+    
+    const char *text = e->lines[l];
+    int len = strlen(text);
+    int rows = 0, start = 0;
+    while (1) {
+        e->wrap_start[l][rows++] = start;
+        if (len - start <= VISIBLE_COLS || rows == MAX_WRAP_ROWS) break;
+        
+        int brk = start + VISIBLE_COLS;
+        for (int i = brk; i > start + VISIBLE_COLS / 2; i--) {
+            if (text[i - 1] == ' ') {
+                brk = i;
+                break;
+            }
+        }
+        start = brk;
+    }
+    e->wrap_rows[l] = rows;
+    return rows;
+}
+
+/*
+ * Lines first..last changed: refresh their highlighting state and
+ * drop their cached wrap positions. Nothing else is recomputed.
+ */
+static void line_info_touch(editor_state_t *e, int first, int last) {
+    syntax_touch(e, first, last);
+    editor_damage(e, first, last);
+    
+    for (int l = first; l <= last; l++) {
+        int old_rows = e->wrap_rows[l];
+        e->wrap_rows[l] = 0;
+        // A line growing or shrinking a row moves everything below it
+        if (e->wrap && old_rows > 0 && editor_line_rows(e, l) != old_rows) {
+            editor_damage(e, l, DAMAGE_TO_END);
+        }
+    }
+}
+
+/*
+ * Columns [*start, *end) of line l shown on its screen row r.
  */
+static void editor_row_span(editor_state_t *e, int l, int r, int *start, int *end) {
+    int len = strlen(e->lines[l]);
+    if (!e->wrap) {
+        *start = e->hscroll;
+        *end = e->hscroll + VISIBLE_COLS;
+    } else {
+        *start = e->wrap_start[l][r];
+        *end = (r + 1 < e->wrap_rows[l]) ? e->wrap_start[l][r + 1] : len;
+        if (*end > *start + VISIBLE_COLS) *end = *start + VISIBLE_COLS;
+    }
+    if (*end > len) *end = len;
+    if (*start > *end) *start = *end;
+}
 
-static void editor_draw(editor_state_t *e, const char *title) {
-    nio_console *console = nio_get_default();
-    nio_clear(console);
+/*
+ * Screen row (from the top of the text area) and column of the
+ * given buffer position. The row is negative or >= VISIBLE_ROWS
+ * when the position is off screen.
+ */
+static void editor_locate(editor_state_t *e, int line, int col, int *row, int *x_col) {
+    if (line < e->scroll_offset) {
+        *row = -1;
+        *x_col = 0;
+        return;
+    }
+    
+    int r = 0;
+    for (int l = e->scroll_offset; l < line && r < VISIBLE_ROWS; l++) {
+        r += editor_line_rows(e, l);
+    }
+    
+    if (!e->wrap) {
+        *row = r;
+        *x_col = col - e->hscroll;
+        return;
+    }
     
-    // Header
+    int rows = editor_line_rows(e, line);
+    int sub = rows - 1;
+    while (sub > 0 && e->wrap_start[line][sub] > col) sub--;
+    *row = r + sub;
+    *x_col = col - e->wrap_start[line][sub];
+}
+
+/*
+ * Draw columns [start, end) of a buffer line as runs of
+ * same-coloured characters, one nio call per run.
+ */
+static void editor_draw_span(editor_state_t *e, int line_idx, int start, int end, int y, unsigned char bg) {
+    const char *text = e->lines[line_idx];
+    char run[MAX_LINE_LEN];
+    
+    if (e->lang == SYN_LANG_NONE) {
+        memcpy(run, text + start, end - start);
+        run[end - start] = '\0';
+        nio_vram_grid_puts(0, y, 0, 0, run, bg, NIO_COLOR_BLACK);
+        return;
+    }
+    
+    unsigned char cls[MAX_LINE_LEN];
+    syntax_ensure(e, line_idx - 1);
+    syntax_lex_line(e->lang, text, (line_idx > 0) ? e->syn_state[line_idx - 1] : SYN_STATE_NORMAL, cls);
+    
+    int pos = start;
+    while (pos < end) {
+        int run_end = pos + 1;
+        while (run_end < end && cls[run_end] == cls[pos]) run_end++;
+        memcpy(run, text + pos, run_end - pos);
+        run[run_end - pos] = '\0';
+        nio_vram_grid_puts((pos - start) * 6, y, 0, 0, run, bg, syntax_colors[cls[pos]]);
+        pos = run_end;
+    }
+}
+
+static void editor_draw_header(editor_state_t *e, const char *title) {
     nio_vram_fill(0, 0, 320, 10, NIO_COLOR_BLUE);
     nio_vram_grid_puts(0, 0, 0, 0, title, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
     
+    if (!e->wrap && e->hscroll > 0) {
+        char col_info[16];
+        snprintf(col_info, sizeof(col_info), ">%d", e->hscroll + 1);
+        nio_vram_grid_puts(240, 0, 0, 0, col_info, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
+    }
     if (e->modified) {
         nio_vram_grid_puts(280, 0, 0, 0, "[*]", NIO_COLOR_BLUE, NIO_COLOR_YELLOW);
     }
+    e->drawn_modified = e->modified;
+}
+
+/*
+ * Draw the editor. status replaces the footer text when not NULL.
+ *
+ * Only damaged lines are repainted into the VRAM buffer, plus the
+ * header when the modified marker toggles. Scrolling, wrap changes,
+ * dialogs and a custom status force a full repaint via dmg_all.
+ */
+static void editor_draw(editor_state_t *e, const char *title, const char *status) {
+    int full = e->dmg_all || status;
     
-    // Text area background (fill entire area with white first)
-    nio_vram_fill(0, 10, 320, 220, NIO_COLOR_WHITE);
+    if (full) {
+        nio_console *console = nio_get_default();
+        nio_clear(console);
+        editor_draw_header(e, title);
+        
+        // Text area background (fill entire area with white first)
+        nio_vram_fill(0, 10, 320, 220, NIO_COLOR_WHITE);
+        
+        // Footer
+        nio_vram_fill(0, 230, 320, 10, NIO_COLOR_GRAY);
+        nio_vram_grid_puts(0, 231, 0, 0, status ? status : "Ctrl:Save ^Z^Y:Undo/Redo ^F:Find ^R:Rep ^W:Wrap",
+                           NIO_COLOR_GRAY, NIO_COLOR_WHITE);
+    } else {
+        if (e->modified != e->drawn_modified) editor_draw_header(e, title);
+        // Scrolled down: move the rows still visible in one block
+        if (e->shift_rows > 0) {
+            ui_shift_up(12, VISIBLE_ROWS * 8, e->shift_rows * 8, NIO_COLOR_WHITE);
+        }
+    }
     
     // Text area
-    for (int i = 0; i < VISIBLE_ROWS && (i + e->scroll_offset) < e->line_count; i++) {
-        int line_idx = i + e->scroll_offset;
-        int y = 12 + (i * 8);
+    int row = 0;
+    for (int line_idx = e->scroll_offset; line_idx < e->line_count && row < VISIBLE_ROWS; line_idx++) {
+        int rows = editor_line_rows(e, line_idx);
+        if (!full && (line_idx < e->dmg_first || line_idx > e->dmg_last)) {
+            row += rows;
+            continue;
+        }
         
         // Highlight current line
-        if (line_idx == e->cursor_line) {
-            nio_vram_fill(0, y, 320, 8, NIO_COLOR_LIGHTBLUE);
-            nio_vram_grid_puts(0, y, 0, 0, e->lines[line_idx], NIO_COLOR_LIGHTBLUE, NIO_COLOR_BLACK);
-        } else {
-            nio_vram_grid_puts(0, y, 0, 0, e->lines[line_idx], NIO_COLOR_WHITE, NIO_COLOR_BLACK);
+        unsigned char bg = (line_idx == e->cursor_line) ? NIO_COLOR_LIGHTBLUE : NIO_COLOR_WHITE;
+        for (int r = 0; r < rows && row < VISIBLE_ROWS; r++, row++) {
+            int y = 12 + (row * 8);
+            int start, end;
+            editor_row_span(e, line_idx, r, &start, &end);
+            nio_vram_fill(0, y, 320, 8, bg);
+            editor_draw_span(e, line_idx, start, end, y, bg);
         }
     }
     
+    // Rows left empty by removed lines
+    if (!full && e->dmg_last == DAMAGE_TO_END && row < VISIBLE_ROWS) {
+        nio_vram_fill(0, 12 + row * 8, 320, (VISIBLE_ROWS - row) * 8, NIO_COLOR_WHITE);
+    }
+    
+    int cursor_row, cursor_col;
+    editor_locate(e, e->cursor_line, e->cursor_col, &cursor_row, &cursor_col);
+    int cursor_y = 12 + (cursor_row * 8);
+    
+    // Current search match
+    if (e->mark_len > 0) {
+        char mark[MAX_QUERY_LEN];
+        int room = VISIBLE_COLS - cursor_col;
+        snprintf(mark, sizeof(mark), "%.*s", e->mark_len < room ? e->mark_len : room,
+                 e->lines[e->cursor_line] + e->cursor_col);
+        nio_vram_grid_puts(cursor_col * 6, cursor_y, 0, 0, mark, NIO_COLOR_YELLOW, NIO_COLOR_BLACK);
+    }
+    
     // Cursor (simple block)
-    int cursor_y = 12 + ((e->cursor_line - e->scroll_offset) * 8);
-    int cursor_x = e->cursor_col * 6; // Approx char width
-    if (cursor_x > 310) cursor_x = 310;
+    int cursor_x = cursor_col * 6;
+    if (cursor_x > 318) cursor_x = 318;
     nio_vram_fill(cursor_x, cursor_y, 2, 8, NIO_COLOR_BLACK);
     
-    // Footer
-    nio_vram_fill(0, 230, 320, 10, NIO_COLOR_GRAY);
-    nio_vram_grid_puts(0, 231, 0, 0, "Ctrl:Save  Esc:Exit", NIO_COLOR_GRAY, NIO_COLOR_WHITE);
-    
     nio_vram_draw();
+    
+    e->dmg_all = 0;
+    e->shift_rows = 0;
+    e->dmg_first = DAMAGE_TO_END + 1;
+    e->dmg_last = -1;
+}
+
+/*
+ * Whether every line of the file fits the buffer, and there are not
+ * too many of them. A missing file fits (it is created on save).
+ */
+int editor_fits(const char *filepath) {
+    struct stat st;
+    if (stat(filepath, &st) != 0) return 1;
+    // Cannot fit even with the shortest lines and CRLF endings
+    if (st.st_size > (off_t)MAX_LINES * (MAX_LINE_LEN + 1)) return 0;
+    
+    FILE *f = fopen(filepath, "rb");
+    if (!f) return 1;
+    int lines = 0;
+    int len = 0; // Characters in the current line, a trailing \r included
+    int prev = 0;
+    int c;
+    int fits = 1;
+    while (fits && (c = getc(f)) != EOF) {
+        if (c == '\n') {
+            if (len - (prev == '\r') > MAX_LINE_LEN - 1) fits = 0;
+            if (++lines > MAX_LINES) fits = 0;
+            len = 0;
+        } else if (++len > MAX_LINE_LEN) { // Room for a \r still to be stripped
+            fits = 0;
+        }
+        prev = c;
+    }
+    // A last line without a newline
+    if (fits && len > 0 && (len > MAX_LINE_LEN - 1 || ++lines > MAX_LINES)) fits = 0;
+    fclose(f);
+    return fits;
 }
 
 /*
  * Load file into editor state. We do sanity checks and 
  * initialize the editor state, sanitize the file, and 
  * load the file into the editor state. After that we 
- * return 1 on success and 0 on failure.
+ * return 1 on success, 0 for a new file, and -1 when the
+ * file does not fit the buffer (nothing is cut).
  */
 static int editor_load(editor_state_t *e, const char *filepath) {
     memset(e, 0, sizeof(*e));
@@ -114,14 +480,28 @@ static int editor_load(editor_state_t *e, const char *filepath) {
     }
     
     e->line_count = 0;
-    char buf[MAX_LINE_LEN];
-    while (fgets(buf, sizeof(buf), f) && e->line_count < MAX_LINES) {
-        // Strip newline
+    // Room for a full line with its \r\n, so a longer one shows as such
+    char buf[MAX_LINE_LEN + 3];
+    while (fgets(buf, sizeof(buf), f)) {
+        if (e->line_count >= MAX_LINES) {
+            fclose(f);
+            return -1;
+        }
+        // Strip newline, remembering the style of the first one
         size_t len = strlen(buf);
-        if (len > 0 && buf[len-1] == '\n') buf[len-1] = '\0';
-        if (len > 1 && buf[len-2] == '\r') buf[len-2] = '\0';
+        if (len > 0 && buf[len-1] == '\n') {
+            buf[len-1] = '\0';
+            if (len > 1 && buf[len-2] == '\r') {
+                buf[len-2] = '\0';
+                if (e->line_count == 0) e->crlf = 1;
+            }
+        }
         
-        strncpy(e->lines[e->line_count], buf, MAX_LINE_LEN - 1);
+        if (strlen(buf) > MAX_LINE_LEN - 1) {
+            fclose(f);
+            return -1;
+        }
+        strcpy(e->lines[e->line_count], buf);
         e->line_count++;
     }
     
@@ -132,24 +512,624 @@ static int editor_load(editor_state_t *e, const char *filepath) {
 }
 
 /*
- * Save the file to disk by writing each line to the file.
- * We also reset the modified flag and return 1 on success
+ * Save the file to disk without ever leaving a half-written file.
+ *
+ * Lines are packed into a chunk buffer and written with one fwrite
+ * per chunk to a sibling temp file, using the line endings the file
+ * was loaded with. Once the temp file is closed and its size checked,
+ * it replaces the original by rename. If the filesystem refuses to
+ * rename over an existing file, the original is moved aside first
+ * and put back should the second rename fail.
+ *
+ * We also reset the modified flag and return 1 on success.
  */
 
+#define SAVE_CHUNK 4096
+
 static int editor_save(editor_state_t *e, const char *filepath) {
-    FILE *f = fopen(filepath, "w");
+    char tmp_path[1024];
+    char bak_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.~tmp", filepath);
+    snprintf(bak_path, sizeof(bak_path), "%s.~bak", filepath);
+    
+    FILE *f = fopen(tmp_path, "wb");
     if (!f) return 0;
     
-    for (int i = 0; i < e->line_count; i++) {
-        fputs(e->lines[i], f);
-        fputc('\n', f);
+    const char *eol = e->crlf ? "\r\n" : "\n";
+    int eol_len = e->crlf ? 2 : 1;
+    
+    char chunk[SAVE_CHUNK];
+    int used = 0;
+    long total = 0;
+    int ok = 1;
+    
+    for (int i = 0; i < e->line_count && ok; i++) {
+        int len = strlen(e->lines[i]);
+        // A line plus its ending always fits in an empty chunk
+        if (used + len + eol_len > SAVE_CHUNK) {
+            ok = (fwrite(chunk, 1, used, f) == (size_t)used);
+            total += used;
+            used = 0;
+        }
+        memcpy(chunk + used, e->lines[i], len);
+        memcpy(chunk + used + len, eol, eol_len);
+        used += len + eol_len;
+    }
+    if (ok && used > 0) {
+        ok = (fwrite(chunk, 1, used, f) == (size_t)used);
+        total += used;
+    }
+    
+    if (fflush(f) != 0 || ferror(f)) ok = 0;
+    if (fclose(f) != 0) ok = 0;
+    
+    // Verify what reached the disk before touching the original
+    struct stat st;
+    if (ok && (stat(tmp_path, &st) != 0 || st.st_size != total)) ok = 0;
+    
+    if (ok && rename(tmp_path, filepath) != 0) {
+        // This filesystem will not rename over a file: move the original
+        // aside first. If the device dies between the two renames, the
+        // original survives as <file>.~bak. A stale one left that way
+        // would make every later save fail, so clear it first.
+        remove(bak_path);
+        int had_original = (rename(filepath, bak_path) == 0);
+        if (rename(tmp_path, filepath) == 0) {
+            if (had_original) remove(bak_path);
+        } else {
+            if (had_original) rename(bak_path, filepath);
+            ok = 0;
+        }
+    }
+    
+    if (!ok) {
+        remove(tmp_path);
+        return 0;
     }
     
-    fclose(f);
     e->modified = 0;
     return 1;
 }
 
+/*
+ * Insert len bytes of text (may contain '\n') at line/col.
+ * Lines below are shifted once for all inserted newlines.
+ * The position after the inserted text is stored in *end_line and
+ * *end_col. Returns 0 (buffer untouched) if the result won't fit.
+ */
+static int buf_insert(editor_state_t *e, int line, int col, const char *text, int len,
+                      int *end_line, int *end_col) {
+    // Measure the segments between newlines before touching anything
+    int newlines = 0, first_seg = -1, max_seg = 0, seg = 0;
+    for (int i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            if (first_seg < 0) first_seg = seg;
+            if (seg > max_seg) max_seg = seg;
+            newlines++;
+            seg = 0;
+        } else {
+            seg++;
+        }
+    }
+    
+    int tail_len = strlen(e->lines[line]) - col;
+    if (e->line_count + newlines > MAX_LINES) return 0;
+    if (newlines == 0) {
+        if (col + len + tail_len > MAX_LINE_LEN - 1) return 0;
+    } else if (col + first_seg > MAX_LINE_LEN - 1 || max_seg > MAX_LINE_LEN - 1 ||
+               seg + tail_len > MAX_LINE_LEN - 1) {
+        return 0;
+    }
+    
+    char tail[MAX_LINE_LEN];
+    strcpy(tail, e->lines[line] + col);
+    
+    if (newlines > 0) {
+        memmove(e->lines[line + 1 + newlines], e->lines[line + 1],
+                (e->line_count - line - 1) * MAX_LINE_LEN);
+        line_info_move(e, line + 1 + newlines, line + 1, e->line_count - line - 1);
+        e->line_count += newlines;
+        editor_damage(e, line, DAMAGE_TO_END);
+        if (e->syn_valid > line + 1) e->syn_valid += newlines;
+    }
+    
+    int l = line, c = col;
+    for (int i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            e->lines[l][c] = '\0';
+            l++;
+            c = 0;
+        } else {
+            e->lines[l][c++] = text[i];
+        }
+    }
+    strcpy(e->lines[l] + c, tail);
+    line_info_touch(e, line, l);
+    
+    *end_line = l;
+    *end_col = c;
+    return 1;
+}
+
+/*
+ * Delete len bytes starting at line/col, where the end of each line
+ * counts as one '\n' byte. The removed text is copied to out (if not
+ * NULL). Returns 0 (buffer untouched) if the range runs past the end
+ * of the buffer or the joined line would not fit.
+ */
+static int buf_delete(editor_state_t *e, int line, int col, int len, char *out) {
+    int l = line, c = col, remaining = len, o = 0;
+    
+    // Find the end of the range
+    while (remaining > 0) {
+        int avail = strlen(e->lines[l]) - c;
+        if (remaining <= avail) {
+            if (out) memcpy(out + o, e->lines[l] + c, remaining);
+            c += remaining;
+            break;
+        }
+        if (l + 1 >= e->line_count) return 0;
+        if (out) {
+            memcpy(out + o, e->lines[l] + c, avail);
+            out[o + avail] = '\n';
+        }
+        o += avail + 1;
+        remaining -= avail + 1;
+        l++;
+        c = 0;
+    }
+    
+    int rest = strlen(e->lines[l] + c);
+    if (col + rest > MAX_LINE_LEN - 1) return 0;
+    
+    memmove(e->lines[line] + col, e->lines[l] + c, rest + 1);
+    if (l > line) {
+        memmove(e->lines[line + 1], e->lines[l + 1], (e->line_count - l - 1) * MAX_LINE_LEN);
+        line_info_move(e, line + 1, l + 1, e->line_count - l - 1);
+        e->line_count -= l - line;
+        editor_damage(e, line, DAMAGE_TO_END);
+        if (e->syn_valid > l + 1) e->syn_valid -= l - line;
+        else if (e->syn_valid > line + 1) e->syn_valid = line + 1;
+    }
+    line_info_touch(e, line, line);
+    return 1;
+}
+
+/*
+ * Drop the oldest undo step (all records of its group) to make room.
+ */
+static void undo_drop_oldest(undo_log_t *u) {
+    int n = 0;
+    while (n < u->count && u->recs[n].group == u->recs[0].group) n++;
+    
+    int bytes = (n < u->count) ? u->recs[n].text_off : u->pool_used;
+    memmove(u->pool, u->pool + bytes, u->pool_used - bytes);
+    u->pool_used -= bytes;
+    
+    memmove(u->recs, u->recs + n, (u->count - n) * sizeof(undo_rec_t));
+    u->count -= n;
+    u->pos -= n;
+    if (u->pos < 0) u->pos = 0;
+    for (int i = 0; i < u->count; i++) u->recs[i].text_off -= bytes;
+}
+
+/*
+ * Append an operation to the undo log, discarding any redo history.
+ *
+ * Single-line typing and backspacing extend the previous record when
+ * the positions are adjacent, so a run of keystrokes is one step.
+ * Operations larger than the whole pool are not recorded and clear
+ * the history, since earlier steps could no longer be replayed.
+ */
+static void undo_record(undo_log_t *u, int type, int line, int col, const char *text, int len,
+                        int can_coalesce) {
+    // New edits invalidate redo
+    u->count = u->pos;
+    u->pool_used = (u->pos > 0) ? u->recs[u->pos - 1].text_off + u->recs[u->pos - 1].len : 0;
+    
+    if (len > UNDO_POOL_SIZE) {
+        u->count = u->pos = u->pool_used = 0;
+        u->coalesce = 0;
+        return;
+    }
+    
+    if (can_coalesce && u->coalesce && u->count > 0 && u->pool_used + len <= UNDO_POOL_SIZE) {
+        undo_rec_t *last = &u->recs[u->count - 1];
+        if (type == UNDO_INSERT && last->type == UNDO_INSERT &&
+            last->line == line && last->col + last->len == col) {
+            memcpy(u->pool + u->pool_used, text, len);
+            last->len += len;
+            u->pool_used += len;
+            return;
+        }
+        if (type == UNDO_DELETE && last->type == UNDO_DELETE &&
+            last->line == line && col + len == last->col) {
+            // Backspacing runs leftwards: prepend the text
+            memmove(u->pool + last->text_off + len, u->pool + last->text_off, last->len);
+            memcpy(u->pool + last->text_off, text, len);
+            last->col = col;
+            last->len += len;
+            u->pool_used += len;
+            return;
+        }
+    }
+    
+    // Anything not absorbed above starts a new step (unless batched)
+    if (!u->batch) u->group++;
+    
+    while (u->count > 0 && (u->count == UNDO_MAX_RECORDS || u->pool_used + len > UNDO_POOL_SIZE)) {
+        undo_drop_oldest(u);
+    }
+    
+    undo_rec_t *r = &u->recs[u->count++];
+    r->type = type;
+    r->line = line;
+    r->col = col;
+    r->group = u->group;
+    r->text_off = u->pool_used;
+    r->len = len;
+    memcpy(u->pool + u->pool_used, text, len);
+    u->pool_used += len;
+    u->pos = u->count;
+    u->coalesce = can_coalesce;
+}
+
+/*
+ * Insert text at the cursor as an undo step (extending the current
+ * keystroke run when coalesce is set) and move the cursor past it.
+ * Returns 0 if it doesn't fit.
+ */
+static int editor_insert(editor_state_t *e, const char *text, int len, int coalesce) {
+    int line = e->cursor_line, col = e->cursor_col;
+    if (!buf_insert(e, line, col, text, len, &e->cursor_line, &e->cursor_col)) return 0;
+    
+    undo_record(&e->undo, UNDO_INSERT, line, col, text, len, coalesce);
+    e->modified = 1;
+    return 1;
+}
+
+/*
+ * Delete len bytes at line/col as an undo step and put the cursor
+ * there. Returns 0 if the range can't be deleted.
+ */
+static int editor_delete(editor_state_t *e, int line, int col, int len, int coalesce) {
+    char text[MAX_LINE_LEN + 1];
+    if (len > (int)sizeof(text)) return 0;
+    if (!buf_delete(e, line, col, len, text)) return 0;
+    
+    undo_record(&e->undo, UNDO_DELETE, line, col, text, len, coalesce);
+    e->cursor_line = line;
+    e->cursor_col = col;
+    e->modified = 1;
+    return 1;
+}
+
+/*
+ * Undo (redo = 0) or redo (redo = 1) one step. Each record is
+ * replayed with the buffer primitives, so the cost is proportional
+ * to the size of the change. Returns 0 if there was nothing to do.
+ */
+static int editor_undo(editor_state_t *e, int redo) {
+    undo_log_t *u = &e->undo;
+    if (redo ? (u->pos >= u->count) : (u->pos == 0)) return 0;
+    
+    int group = u->recs[redo ? u->pos : u->pos - 1].group;
+    while (redo ? (u->pos < u->count) : (u->pos > 0)) {
+        undo_rec_t *r = &u->recs[redo ? u->pos : u->pos - 1];
+        if (r->group != group) break;
+        
+        // Inserting on redo of an insert or undo of a delete
+        if ((r->type == UNDO_INSERT) == redo) {
+            buf_insert(e, r->line, r->col, u->pool + r->text_off, r->len,
+                       &e->cursor_line, &e->cursor_col);
+        } else {
+            buf_delete(e, r->line, r->col, r->len, NULL);
+            e->cursor_line = r->line;
+            e->cursor_col = r->col;
+        }
+        u->pos += redo ? 1 : -1;
+    }
+    
+    u->coalesce = 0;
+    e->modified = 1;
+    return 1;
+}
+
+/*
+ * Keep the cursor inside the visible rows and, without wrap,
+ * inside the visible columns.
+ */
+static void editor_scroll_to_cursor(editor_state_t *e) {
+    if (e->cursor_line < e->scroll_offset) e->scroll_offset = e->cursor_line;
+    
+    if (e->wrap) {
+        // Every line takes at least one row
+        if (e->scroll_offset < e->cursor_line - VISIBLE_ROWS)
+            e->scroll_offset = e->cursor_line - VISIBLE_ROWS;
+        
+        int row, col;
+        editor_locate(e, e->cursor_line, e->cursor_col, &row, &col);
+        while (row >= VISIBLE_ROWS && e->scroll_offset < e->cursor_line) {
+            e->scroll_offset++;
+            editor_locate(e, e->cursor_line, e->cursor_col, &row, &col);
+        }
+        return;
+    }
+    
+    if (e->cursor_line >= e->scroll_offset + VISIBLE_ROWS)
+        e->scroll_offset = e->cursor_line - VISIBLE_ROWS + 1;
+    
+    if (e->cursor_col < e->hscroll) {
+        e->hscroll = e->cursor_col - HSCROLL_STEP;
+        if (e->hscroll < 0) e->hscroll = 0;
+    } else if (e->cursor_col >= e->hscroll + VISIBLE_COLS) {
+        e->hscroll = e->cursor_col - VISIBLE_COLS + HSCROLL_STEP;
+    }
+}
+
+/*
+ * Rebuild the match list of the current query from scratch.
+ */
+static void search_scan(editor_state_t *e) {
+    search_state_t *s = &e->search;
+    s->match_count = 0;
+    s->complete = 1;
+    if (s->len == 0) return;
+    
+    for (int l = 0; l < e->line_count; l++) {
+        const char *p = e->lines[l];
+        while ((p = strstr(p, s->query)) != NULL) {
+            if (s->match_count == MAX_MATCHES) {
+                s->complete = 0;
+                return;
+            }
+            s->match_line[s->match_count] = l;
+            s->match_col[s->match_count] = p - e->lines[l];
+            s->match_count++;
+            p++;
+        }
+    }
+}
+
+/*
+ * The query grew by its last character: keep only the previous
+ * matches that are still followed by it. Falls back to a full scan
+ * if the previous list was incomplete.
+ */
+static void search_extend(editor_state_t *e) {
+    search_state_t *s = &e->search;
+    if (!s->complete || s->len == 1) {
+        search_scan(e);
+        return;
+    }
+    
+    char ch = s->query[s->len - 1];
+    int kept = 0;
+    for (int i = 0; i < s->match_count; i++) {
+        const char *line = e->lines[s->match_line[i]];
+        int col = s->match_col[i];
+        // Earlier characters already matched, so the line is long enough
+        if (line[col + s->len - 1] == ch) {
+            s->match_line[kept] = s->match_line[i];
+            s->match_col[kept] = col;
+            kept++;
+        }
+    }
+    s->match_count = kept;
+}
+
+/*
+ * Index of the first match at or after line/col, wrapping around.
+ */
+static int search_first_from(search_state_t *s, int line, int col) {
+    for (int i = 0; i < s->match_count; i++) {
+        if (s->match_line[i] > line || (s->match_line[i] == line && s->match_col[i] >= col)) return i;
+    }
+    return 0;
+}
+
+/*
+ * Incremental find. The cursor follows the first match after where
+ * the search started while the query is typed; Up/Down step through
+ * the matches. Enter keeps the position, Esc returns to the start.
+ */
+static void editor_find(editor_state_t *e, const char *title) {
+    search_state_t *s = &e->search;
+    int origin_line = e->cursor_line;
+    int origin_col = e->cursor_col;
+    int origin_scroll = e->scroll_offset;
+    
+    search_scan(e);
+    int current = search_first_from(s, origin_line, origin_col);
+    
+    while (1) {
+        if (s->match_count > 0) {
+            e->cursor_line = s->match_line[current];
+            e->cursor_col = s->match_col[current];
+            e->mark_len = s->len;
+        } else {
+            e->cursor_line = origin_line;
+            e->cursor_col = origin_col;
+            e->mark_len = 0;
+        }
+        editor_scroll_to_cursor(e);
+        
+        char status[64];
+        snprintf(status, sizeof(status), "Find: %s_  %d/%d%s", s->query,
+                 s->match_count ? current + 1 : 0, s->match_count, s->complete ? "" : "+");
+        editor_draw(e, title, status);
+        
+        int c = input_get_key();
+        
+        if (c == NIO_KEY_ESC) {
+            e->cursor_line = origin_line;
+            e->cursor_col = origin_col;
+            e->scroll_offset = origin_scroll;
+            break;
+        } else if (c == NIO_KEY_ENTER) {
+            break;
+        } else if (c == NIO_KEY_DOWN || c == NIO_KEY_FIND_NEXT) {
+            if (s->match_count > 0) current = (current + 1) % s->match_count;
+        } else if (c == NIO_KEY_UP) {
+            if (s->match_count > 0) current = (current - 1 + s->match_count) % s->match_count;
+        } else if (c == 8 || c == 0x7F) { // Backspace
+            if (s->len > 0) {
+                s->query[--s->len] = '\0';
+                search_scan(e);
+                current = search_first_from(s, origin_line, origin_col);
+            }
+        } else if (c >= 32 && c <= 126) { // Printable
+            if (s->len < MAX_QUERY_LEN - 1) {
+                s->query[s->len++] = (char)c;
+                s->query[s->len] = '\0';
+                search_extend(e);
+                current = search_first_from(s, origin_line, origin_col);
+            }
+        }
+    }
+    
+    e->mark_len = 0;
+    e->undo.coalesce = 0;
+    e->dmg_all = 1;
+}
+
+/*
+ * Move the cursor to the next occurrence of the last query after
+ * the cursor, wrapping around. Returns 0 if there is none.
+ */
+static int editor_find_next(editor_state_t *e) {
+    search_state_t *s = &e->search;
+    if (s->len == 0) return 0;
+    
+    for (int i = 0; i <= e->line_count; i++) {
+        int l = (e->cursor_line + i) % e->line_count;
+        const char *line = e->lines[l];
+        const char *p;
+        if (i == 0) {
+            // Only past the cursor on its own line
+            p = (e->cursor_col < (int)strlen(line)) ? strstr(line + e->cursor_col + 1, s->query) : NULL;
+        } else {
+            p = strstr(line, s->query);
+        }
+        if (p) {
+            e->cursor_line = l;
+            e->cursor_col = p - e->lines[l];
+            e->undo.coalesce = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Replace every occurrence of find with repl as one transaction.
+ *
+ * Each affected line is rebuilt in a single left-to-right pass into
+ * a scratch line and copied back once. The whole batch is one undo
+ * step; if it is too big for the undo log, the user is asked first
+ * and the history is cleared. Returns the number of replacements.
+ */
+static int editor_replace_all(editor_state_t *e, const char *find, const char *repl) {
+    int find_len = strlen(find);
+    int repl_len = strlen(repl);
+    if (find_len == 0) return 0;
+    
+    // Dry run: size the undo records (old + new text of each line)
+    int changed_lines = 0, undo_bytes = 0;
+    for (int l = 0; l < e->line_count; l++) {
+        int hits = 0;
+        const char *p = e->lines[l];
+        while ((p = strstr(p, find)) != NULL) {
+            hits++;
+            p += find_len;
+        }
+        if (hits == 0) continue;
+        int old_len = strlen(e->lines[l]);
+        changed_lines++;
+        undo_bytes += old_len * 2 + hits * (repl_len - find_len);
+    }
+    if (changed_lines == 0) return 0;
+    
+    undo_log_t *u = &e->undo;
+    int record = (undo_bytes <= UNDO_POOL_SIZE && changed_lines * 2 <= UNDO_MAX_RECORDS);
+    if (!record) {
+        if (!ui_get_confirmation("Too big to undo. Replace?")) return 0;
+        u->count = u->pos = u->pool_used = 0;
+    }
+    
+    u->group++;
+    u->batch = 1;
+    u->coalesce = 0;
+    
+    int count = 0;
+    char out[MAX_LINE_LEN];
+    for (int l = 0; l < e->line_count; l++) {
+        char *line = e->lines[l];
+        char *hit = strstr(line, find);
+        if (!hit) continue;
+        
+        // Build the new line in one pass
+        int o = 0, hits = 0, fits = 1;
+        const char *p = line;
+        while (hit) {
+            int keep = hit - p;
+            if (o + keep + repl_len > MAX_LINE_LEN - 1) {
+                fits = 0;
+                break;
+            }
+            memcpy(out + o, p, keep);
+            memcpy(out + o + keep, repl, repl_len);
+            o += keep + repl_len;
+            hits++;
+            p = hit + find_len;
+            hit = strstr(p, find);
+        }
+        int rest = strlen(p);
+        if (!fits || o + rest > MAX_LINE_LEN - 1) continue; // Line would overflow: skip it
+        memcpy(out + o, p, rest + 1);
+        
+        if (record) {
+            undo_record(u, UNDO_DELETE, l, 0, line, strlen(line), 0);
+            undo_record(u, UNDO_INSERT, l, 0, out, o + rest, 0);
+        }
+        memcpy(line, out, o + rest + 1);
+        line_info_touch(e, l, l);
+        count += hits;
+    }
+    
+    u->batch = 0;
+    if (count > 0) {
+        e->modified = 1;
+        int len = strlen(e->lines[e->cursor_line]);
+        if (e->cursor_col > len) e->cursor_col = len;
+    }
+    return count;
+}
+
+/*
+ * Prompt for the search and replacement strings and replace all.
+ */
+static void editor_replace_prompt(editor_state_t *e) {
+    char find[MAX_QUERY_LEN];
+    char repl[MAX_QUERY_LEN] = "";
+    strcpy(find, e->search.query);
+    
+    if (!ui_get_string("Replace:", find, sizeof(find)) || find[0] == '\0') return;
+    if (!ui_get_string("With:", repl, sizeof(repl))) return;
+    
+    int n = editor_replace_all(e, find, repl);
+    
+    // Remember the query for find next
+    strcpy(e->search.query, find);
+    e->search.len = strlen(find);
+    
+    char msg[48];
+    snprintf(msg, sizeof(msg), "Replaced %d", n);
+    ui_draw_modal(msg);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
 /*
  * Open the file in the editor.
  *
@@ -157,119 +1137,149 @@ static int editor_save(editor_state_t *e, const char *filepath) {
  * and enter the main loop where we handle user input and update the editor state.
  */
 int editor_open(const char *filepath) {
-    editor_state_t e;
-    editor_load(&e, filepath);
+    // Buffer plus undo log is too big for the stack
+    editor_state_t *e = malloc(sizeof(editor_state_t));
+    if (!e) {
+        ui_draw_modal("Error: Out of memory.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return 0;
+    }
+    if (editor_load(e, filepath) < 0) {
+        // Editing part of it would lose the rest on save
+        free(e);
+        ui_draw_modal("File too long for the editor");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return 0;
+    }
+    e->lang = syntax_detect(filepath);
+    e->dmg_all = 1;
     
     // Extract filename for title
     const char *title = strrchr(filepath, '/');
     if (title) title++; else title = filepath;
     
+    int result = 0;
     while (1) {
-        editor_draw(&e, title);
+        editor_draw(e, title, NULL);
         
         int c = input_get_key();
         
+        // View state before the key, to work out what to repaint
+        int prev_line = e->cursor_line;
+        int prev_scroll = e->scroll_offset;
+        int prev_hscroll = e->hscroll;
+        int prev_wrap = e->wrap;
+        
         if (c == NIO_KEY_ESC) {
             // Exit
-            if (e.modified) {
+            if (e->modified) {
                 if (ui_get_confirmation("Discard changes?")) {
-                    return 0; // Exit without saving
+                    break; // Exit without saving
                 }
                 // Else: Cancel exit, return to editor
             } else {
-                return 0; // No changes, exit immediately
+                break; // No changes, exit immediately
             }
         } else if (c == NIO_KEY_MENU) {
             // Save (Ctrl/Menu = Save)
             if (ui_get_confirmation("Save changes?")) {
-                if (editor_save(&e, filepath)) {
+                if (editor_save(e, filepath)) {
                     ui_draw_modal("Saved");
                     wait_key_pressed();
                     wait_no_key_pressed();
-                    return 1;
+                    result = 1;
+                    break;
                 }
+                ui_draw_modal("Save failed");
+                wait_key_pressed();
+                wait_no_key_pressed();
             }
+        } else if (c == NIO_KEY_FIND) {
+            editor_find(e, title);
+        } else if (c == NIO_KEY_FIND_NEXT) {
+            editor_find_next(e);
+        } else if (c == NIO_KEY_REPLACE) {
+            editor_replace_prompt(e);
+        } else if (c == NIO_KEY_WRAP) {
+            e->wrap = !e->wrap;
+            e->hscroll = 0;
+        } else if (c == NIO_KEY_UNDO) {
+            editor_undo(e, 0);
+        } else if (c == NIO_KEY_REDO) {
+            editor_undo(e, 1);
         } else if (c == NIO_KEY_UP) {
-            if (e.cursor_line > 0) {
-                e.cursor_line--;
-                if (e.cursor_line < e.scroll_offset) e.scroll_offset--;
-                if (e.cursor_col > (int)strlen(e.lines[e.cursor_line]))
-                    e.cursor_col = strlen(e.lines[e.cursor_line]);
+            if (e->cursor_line > 0) {
+                e->cursor_line--;
+                if (e->cursor_col > (int)strlen(e->lines[e->cursor_line]))
+                    e->cursor_col = strlen(e->lines[e->cursor_line]);
             }
+            e->undo.coalesce = 0;
         } else if (c == NIO_KEY_DOWN) {
-            if (e.cursor_line < e.line_count - 1) {
-                e.cursor_line++;
-                if (e.cursor_line >= e.scroll_offset + VISIBLE_ROWS) e.scroll_offset++;
-                if (e.cursor_col > (int)strlen(e.lines[e.cursor_line]))
-                    e.cursor_col = strlen(e.lines[e.cursor_line]);
+            if (e->cursor_line < e->line_count - 1) {
+                e->cursor_line++;
+                if (e->cursor_col > (int)strlen(e->lines[e->cursor_line]))
+                    e->cursor_col = strlen(e->lines[e->cursor_line]);
             }
+            e->undo.coalesce = 0;
         } else if (c == NIO_KEY_LEFT) {
-            if (e.cursor_col > 0) {
-                e.cursor_col--;
-            } else if (e.cursor_line > 0) {
-                e.cursor_line--;
-                e.cursor_col = strlen(e.lines[e.cursor_line]);
+            if (e->cursor_col > 0) {
+                e->cursor_col--;
+            } else if (e->cursor_line > 0) {
+                e->cursor_line--;
+                e->cursor_col = strlen(e->lines[e->cursor_line]);
             }
+            e->undo.coalesce = 0;
         } else if (c == NIO_KEY_RIGHT) {
-            if (e.cursor_col < (int)strlen(e.lines[e.cursor_line])) {
-                e.cursor_col++;
-            } else if (e.cursor_line < e.line_count - 1) {
-                e.cursor_line++;
-                e.cursor_col = 0;
+            if (e->cursor_col < (int)strlen(e->lines[e->cursor_line])) {
+                e->cursor_col++;
+            } else if (e->cursor_line < e->line_count - 1) {
+                e->cursor_line++;
+                e->cursor_col = 0;
             }
+            e->undo.coalesce = 0;
         } else if (c == NIO_KEY_ENTER) {
-            // Insert new line
-            if (e.line_count < MAX_LINES) {
-                // Shift lines down
-                for (int i = e.line_count; i > e.cursor_line + 1; i--) {
-                    strcpy(e.lines[i], e.lines[i-1]);
-                }
-                e.line_count++;
-                
-                // Split current line
-                char *cur = e.lines[e.cursor_line];
-                strcpy(e.lines[e.cursor_line + 1], cur + e.cursor_col);
-                cur[e.cursor_col] = '\0';
-                
-                e.cursor_line++;
-                e.cursor_col = 0;
-                e.modified = 1;
-            }
+            // Split the current line (its own undo step)
+            editor_insert(e, "\n", 1, 0);
         } else if (c == 8 || c == 0x7F) { // Backspace
-            if (e.cursor_col > 0) {
-                char *cur = e.lines[e.cursor_line];
-                memmove(cur + e.cursor_col - 1, cur + e.cursor_col, strlen(cur + e.cursor_col) + 1);
-                e.cursor_col--;
-                e.modified = 1;
-            } else if (e.cursor_line > 0) {
+            if (e->cursor_col > 0) {
+                editor_delete(e, e->cursor_line, e->cursor_col - 1, 1, 1);
+            } else if (e->cursor_line > 0) {
                 // Merge with previous line
-                int prev_len = strlen(e.lines[e.cursor_line - 1]);
-                int cur_len = strlen(e.lines[e.cursor_line]);
-                if (prev_len + cur_len < MAX_LINE_LEN - 1) {
-                    // Use temp buffer to avoid overlap
-                    char temp[MAX_LINE_LEN];
-                    strcpy(temp, e.lines[e.cursor_line]);
-                    strcat(e.lines[e.cursor_line - 1], temp);
-                    
-                    // Shift lines up
-                    for (int i = e.cursor_line; i < e.line_count - 1; i++) {
-                        strcpy(e.lines[i], e.lines[i+1]);
-                    }
-                    e.line_count--;
-                    e.cursor_line--;
-                    e.cursor_col = prev_len;
-                    e.modified = 1;
-                }
+                int prev = e->cursor_line - 1;
+                editor_delete(e, prev, strlen(e->lines[prev]), 1, 0);
             }
         } else if (c >= 32 && c <= 126) { // Printable
-            char *cur = e.lines[e.cursor_line];
-            int len = strlen(cur);
-            if (len < MAX_LINE_LEN - 2) {
-                memmove(cur + e.cursor_col + 1, cur + e.cursor_col, len - e.cursor_col + 1);
-                cur[e.cursor_col] = (char)c;
-                e.cursor_col++;
-                e.modified = 1;
+            char ch = (char)c;
+            editor_insert(e, &ch, 1, 1);
+        }
+        
+        editor_scroll_to_cursor(e);
+        
+        // Dialogs draw over the text; scrolling moves every row
+        if (c == NIO_KEY_ESC || c == NIO_KEY_MENU || c == NIO_KEY_REPLACE ||
+            e->hscroll != prev_hscroll || e->wrap != prev_wrap) {
+            e->dmg_all = 1;
+        } else if (e->scroll_offset == prev_scroll + 1 &&
+                   editor_line_rows(e, prev_scroll) < VISIBLE_ROWS) {
+            // One line scrolled off the top: shift the rest up and
+            // repaint only the lines that reach the exposed rows
+            e->shift_rows = editor_line_rows(e, prev_scroll);
+            int row = 0, l = e->scroll_offset;
+            while (l < e->line_count && row + editor_line_rows(e, l) <= VISIBLE_ROWS - e->shift_rows) {
+                row += editor_line_rows(e, l);
+                l++;
             }
+            editor_damage(e, l, DAMAGE_TO_END);
+        } else if (e->scroll_offset != prev_scroll) {
+            e->dmg_all = 1;
         }
+        // Cursor line highlight moves between these two lines
+        editor_damage(e, prev_line, prev_line);
+        editor_damage(e, e->cursor_line, e->cursor_line);
     }
+    
+    free(e);
+    return result;
 }
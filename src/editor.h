@@ -1,6 +1,11 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+// Whether the editor buffer can hold the whole file (256 lines of up
+// to 127 characters). Files that do not fit go to the text viewer;
+// the editor refuses them rather than save back a cut copy.
+int editor_fits(const char *filepath);
+
 // Simple text editor
 // Returns 1 if saved, 0 if cancelled
 int editor_open(const char *filepath);
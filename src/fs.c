@@ -24,6 +24,7 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include "fs.h"
+#include "checksum.h"
 
 
 /* Free file list. Entries are not freed. */
@@ -79,6 +80,7 @@ int fs_scan(const char *path, file_list_t *list) {
         if (strcmp(dir->d_name, "..") == 0) {
             entry->is_dir = 1;
             entry->size = 0;
+            entry->mtime = 0;
         } else {
             // Stat to check type
             char fullpath[1024];
@@ -88,9 +90,11 @@ int fs_scan(const char *path, file_list_t *list) {
             if (stat(fullpath, &st) == 0) {
                 entry->is_dir = S_ISDIR(st.st_mode);
                 entry->size = (unsigned int)st.st_size;
+                entry->mtime = (unsigned int)st.st_mtime;
             } else {
                 entry->is_dir = 0;
                 entry->size = 0;
+                entry->mtime = 0;
             }
         }
         
@@ -108,6 +112,8 @@ int fs_scan(const char *path, file_list_t *list) {
 * It uses the standard C library functions to copy the file.
 */
 
+int fs_verify_copies = 0;
+
 int fs_copy_file(const char *src_path, const char *dst_path) {
     FILE *in = fopen(src_path, "rb");
     if (!in) return -1;
@@ -118,9 +124,13 @@ int fs_copy_file(const char *src_path, const char *dst_path) {
         return -2;
     }
     
-    char buf[4096];
+    // With verification the source's CRC is taken on the way through,
+    // so only the copy is read a second time
+    unsigned char buf[4096];
     size_t n;
+    uint32_t crc = 0;
     while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fs_verify_copies) crc = checksum_crc32(crc, buf, n);
         if (fwrite(buf, 1, n, out) != n) {
             fclose(in);
             fclose(out);
@@ -129,8 +139,15 @@ int fs_copy_file(const char *src_path, const char *dst_path) {
     }
     
     fclose(in);
+    if (fclose(out) != 0) return -3;
+    if (!fs_verify_copies) return 0;
+    
+    out = fopen(dst_path, "rb");
+    if (!out) return -4;
+    uint32_t copy_crc = 0;
+    while ((n = fread(buf, 1, sizeof(buf), out)) > 0) copy_crc = checksum_crc32(copy_crc, buf, n);
     fclose(out);
-    return 0;
+    return copy_crc == crc ? 0 : -4;
 }
 
 /*
@@ -278,3 +295,36 @@ void fs_sort(file_list_t *list, int mode) {
         qsort(list->entries, list->count, sizeof(file_entry_t), compare_name);
     }
 }
+
+/*
+ * Insert entry where a list sorted by mode would have it, or replace
+ * the entry with the same name (a file that was overwritten).
+ */
+int fs_list_insert(file_list_t *list, const file_entry_t *entry, int mode) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->entries[i].name, entry->name) == 0) {
+            // Same position unless the size (the sort key) changed
+            fs_list_remove(list, i);
+            break;
+        }
+    }
+    
+    file_entry_t *new_entries = realloc(list->entries, sizeof(file_entry_t) * (list->count + 1));
+    if (!new_entries) return -1;
+    list->entries = new_entries;
+    
+    int (*compare)(const void *, const void *) = mode == SORT_SIZE ? compare_size : compare_name;
+    int pos = 0;
+    while (pos < list->count && compare(&list->entries[pos], entry) <= 0) pos++;
+    
+    memmove(&list->entries[pos + 1], &list->entries[pos], sizeof(file_entry_t) * (list->count - pos));
+    list->entries[pos] = *entry;
+    list->count++;
+    return pos;
+}
+
+void fs_list_remove(file_list_t *list, int index) {
+    if (index < 0 || index >= list->count) return;
+    memmove(&list->entries[index], &list->entries[index + 1], sizeof(file_entry_t) * (list->count - index - 1));
+    list->count--;
+}
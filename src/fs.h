@@ -5,6 +5,7 @@ typedef struct {
     char name[256];
     int is_dir;
     unsigned int size;
+    unsigned int mtime;
 } file_entry_t;
 
 typedef struct {
@@ -15,7 +16,12 @@ typedef struct {
 
 int fs_scan(const char *path, file_list_t *list);
 void fs_free(file_list_t *list);
+// Returns 0, -1 (source), -2 (destination), -3 (write) or -4 when
+// fs_verify_copies is set and the copy read back differs
 int fs_copy_file(const char *src_path, const char *dst_path);
+
+// Read every copy back and compare its CRC-32 with the source's
+extern int fs_verify_copies;
 int fs_generate_copy_name(const char *original_path, char *out_path, size_t out_size);
 int fs_delete_recursive(const char *path);
 
@@ -24,4 +30,11 @@ int fs_delete_recursive(const char *path);
 
 void fs_sort(file_list_t *list, int mode);
 
+// Patch a listing after a change made by the app itself, instead of
+// scanning the folder again. fs_list_insert keeps a list sorted by
+// mode in order, replaces an entry of the same name, and returns the
+// entry's index (-1 when out of memory).
+int fs_list_insert(file_list_t *list, const file_entry_t *entry, int mode);
+void fs_list_remove(file_list_t *list, int index);
+
 #endif
@@ -4,6 +4,20 @@
  * Uses stb_image for decoding and direct VRAM access for rendering.
  * NIO's nio_vram_pixel_set uses a 256-color palette, not raw RGB565,
  * so we bypass it and use lcd_blit directly for true-color display.
+ *
+ * Rows are converted to RGB565 by color.c, dithered with the mode
+ * D cycles through (error diffusion by default). On the grayscale
+ * models the fitted view is scaled straight into a 4bpp buffer,
+ * luminance computed in the scaler, which is a quarter of the size
+ * and saves lcd_blit a second conversion.
+ *
+ * The image opens fitted to the screen. +/- zoom through power-of-two
+ * levels down to 1:1 and the arrows pan. Zoomed views are drawn from
+ * 64x64 RGB565 tiles of each level, built on demand and kept in an
+ * LRU cache under TILE_BUDGET bytes, so panning only converts the
+ * tiles that scroll into view.
+ *
+ * GIFs are played instead (see gif_play below), a frame at a time.
  */
 
 
@@ -13,13 +27,26 @@
 #include <stdio.h>
 #include <string.h>
 
+/*
+ * Only the decoders listed in image_formats below are compiled in.
+ * Adding a format means adding both its STBI_ONLY_ line and its
+ * table entries.
+ */
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_TGA
+#define STBI_ONLY_GIF
 #define STBI_NO_STDIO
 #define STBI_NO_LINEAR
 #define STBI_NO_HDR
+#define STBI_NO_FAILURE_STRINGS // stbi_failure_reason is never shown
 #include "stb_image.h"
 
 #include "image_viewer.h"
+#include "render_cache.h"
+#include "color.h"
 #include "ui.h" // For ui_draw_modal
 #include "input.h" // For input_get_key
 
@@ -32,15 +59,200 @@
 #define MAX_FILE_SIZE (10 * 1024 * 1024)  // 10 MB max file size
 #define MAX_IMAGE_DIM 8192                // Max 8192x8192 pixels
 
-void image_viewer_open(const char *path) {
-    // 1. Read file to memory
+#define SCREEN_W 320
+#define SCREEN_H 240
+
+// Screen buffers are allocated for RGB565; gray renders use the first quarter
+#define COLOR_BYTES (SCREEN_W * SCREEN_H * (int)sizeof(uint16_t))
+#define GRAY_BYTES (SCREEN_W * SCREEN_H / 2)
+
+static int gray_display = 0; // Set when the viewer opens
+
+/*
+ * Check whether the screen is a grayscale one.
+ */
+static void detect_display(void) {
+    gray_display = !has_colors || lcd_type() == SCR_320x240_4;
+}
+
+// Size of a render in the current screen format
+#define RENDER_SIZE (gray_display ? GRAY_BYTES : COLOR_BYTES)
+
+static void blit(uint16_t *vram) {
+    lcd_blit(vram, gray_display ? SCR_320x240_4 : SCR_320x240_565);
+}
+
+/*
+ * Format capability table: the extensions routed to the viewer and
+ * the stb_image decoder that handles each. Must match the STBI_ONLY_
+ * defines above.
+ */
+typedef struct {
+    const char *ext;
+    const char *name;
+} image_format_t;
+
+static const image_format_t image_formats[] = {
+    { ".png",  "PNG" },
+    { ".jpg",  "JPEG" },
+    { ".jpeg", "JPEG" },
+    { ".bmp",  "BMP" },
+    { ".tga",  "TGA" },
+    { ".gif",  "GIF" },
+};
+
+#define IMAGE_FORMAT_COUNT ((int)(sizeof(image_formats) / sizeof(image_formats[0])))
+
+/*
+ * Returns the decoder name for a file name, or NULL if no compiled-in
+ * decoder handles it. The .tns suffix the OS requires is ignored
+ * (e.g. image.png.tns).
+ */
+const char *image_viewer_format(const char *name) {
+    int len = strlen(name);
+    if (len > 4 && strcasecmp(name + len - 4, ".tns") == 0) len -= 4;
+    
+    for (int i = 0; i < IMAGE_FORMAT_COUNT; i++) {
+        int ext_len = strlen(image_formats[i].ext);
+        if (len > ext_len && strncasecmp(name + len - ext_len, image_formats[i].ext, ext_len) == 0) {
+            return image_formats[i].name;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns 1 if the file name has an extension the viewer can decode.
+ */
+int image_viewer_is_image(const char *name) {
+    return image_viewer_format(name) != NULL;
+}
+
+/*
+ * stb_image callbacks over a FILE*, so the compressed file never
+ * has to be held in memory.
+ */
+static int file_read(void *user, char *data, int size) {
+    return fread(data, 1, size, (FILE *)user);
+}
+
+static void file_skip(void *user, int n) {
+    fseek((FILE *)user, n, SEEK_CUR);
+}
+
+static int file_eof(void *user) {
+    return feof((FILE *)user);
+}
+
+static const stbi_io_callbacks file_callbacks = { file_read, file_skip, file_eof };
+
+/*
+ * Average the RGB888 pixels of the block [x0,x1) x [y0,y1) into rgb,
+ * using at most 4x4 samples.
+ */
+static void box_average(const unsigned char *data, int w, int x0, int x1, int y0, int y1,
+                        unsigned char *rgb) {
+    int xs = (x1 - x0 + 3) / 4;
+    int ys = (y1 - y0 + 3) / 4;
+    unsigned int r = 0, g = 0, b = 0, count = 0;
+    
+    for (int sy = y0; sy < y1; sy += ys) {
+        const unsigned char *p = data + (sy * w + x0) * 3;
+        for (int sx = x0; sx < x1; sx += xs, p += xs * 3) {
+            r += p[0];
+            g += p[1];
+            b += p[2];
+            count++;
+        }
+    }
+    rgb[0] = r / count;
+    rgb[1] = g / count;
+    rgb[2] = b / count;
+}
+
+/*
+ * Decode an image into a tw x th RGB565 thumbnail, letterboxed on
+ * black. The file is streamed into the decoder and each thumbnail
+ * pixel is averaged from its block of the decoded image before the
+ * full-size image is freed.
+ * Returns 0 on success, -1 on failure.
+ */
+int image_decode_thumbnail(const char *path, uint16_t *out, int tw, int th) {
+    if (tw > SCREEN_W || th > SCREEN_H) return -1;
     FILE *f = fopen(path, "rb");
-    if (!f) {
-        ui_draw_modal("Error: Could not open file.");
+    if (!f) return -1;
+    
+    // Reject oversized images before decoding anything
+    int w, h, n;
+    if (!stbi_info_from_callbacks(&file_callbacks, f, &w, &h, &n) ||
+        w <= 0 || h <= 0 || w > MAX_IMAGE_DIM || h > MAX_IMAGE_DIM) {
+        fclose(f);
+        return -1;
+    }
+    fseek(f, 0, SEEK_SET);
+    unsigned char *data = stbi_load_from_callbacks(&file_callbacks, f, &w, &h, &n, 3);
+    fclose(f);
+    if (!data) return -1;
+    
+    // Fit inside the thumbnail, keeping the aspect ratio
+    int dw = tw, dh = (h * tw) / w;
+    if (dh > th) {
+        dh = th;
+        dw = (w * th) / h;
+    }
+    if (dw < 1) dw = 1;
+    if (dh < 1) dh = 1;
+    int ox = (tw - dw) / 2;
+    int oy = (th - dh) / 2;
+    
+    unsigned char row[SCREEN_W * 3];
+    memset(out, 0, tw * th * sizeof(uint16_t));
+    for (int y = 0; y < dh; y++) {
+        int y0 = (y * h) / dh;
+        int y1 = ((y + 1) * h) / dh;
+        if (y1 <= y0) y1 = y0 + 1;
+        
+        for (int x = 0; x < dw; x++) {
+            int x0 = (x * w) / dw;
+            int x1 = ((x + 1) * w) / dw;
+            if (x1 <= x0) x1 = x0 + 1;
+            box_average(data, w, x0, x1, y0, y1, row + x * 3);
+        }
+        // Ordered dither: cached thumbnails do not depend on the mode
+        color_row_565(row, out + (oy + y) * tw + ox, dw, ox, oy + y, COLOR_DITHER_ORDERED);
+    }
+    
+    stbi_image_free(data);
+    return 0;
+}
+
+// Decoded image (RGB888), kept while viewing so tiles can be built
+typedef struct {
+    unsigned char *data;
+    int w, h;
+} image_t;
+
+/*
+ * Report a load error with a modal, unless quiet (background
+ * pre-decode). Always returns -1.
+ */
+static int load_error(const char *msg, int quiet) {
+    if (!quiet) {
+        ui_draw_modal(msg);
         wait_key_pressed();
         wait_no_key_pressed();
-        return;
     }
+    return -1;
+}
+
+/*
+ * Read and decode a file, reporting errors with a modal unless
+ * quiet. Returns 0 on success, -1 on failure.
+ */
+static int image_load(const char *path, image_t *img, int quiet) {
+    // 1. Read file to memory
+    FILE *f = fopen(path, "rb");
+    if (!f) return load_error("Error: Could not open file.", quiet);
     fseek(f, 0, SEEK_END);
     long fsize = ftell(f);
     fseek(f, 0, SEEK_SET);
@@ -48,36 +260,24 @@ void image_viewer_open(const char *path) {
     // Security: Validate file size
     if (fsize <= 0) {
         fclose(f);
-        ui_draw_modal("Error: Invalid file size.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
+        return load_error("Error: Invalid file size.", quiet);
     }
     if (fsize > MAX_FILE_SIZE) {
         fclose(f);
-        ui_draw_modal("Error: File too large (>10MB).");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
+        return load_error("Error: File too large (>10MB).", quiet);
     }
 
     unsigned char *buffer = (unsigned char*)malloc(fsize);
     if (!buffer) {
         fclose(f);
-        ui_draw_modal("Error: Out of memory.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
+        return load_error("Error: Out of memory.", quiet);
     }
     size_t read_bytes = fread(buffer, 1, fsize, f);
     fclose(f);
     
     if (read_bytes != (size_t)fsize) {
         free(buffer);
-        ui_draw_modal("Error: File read mismatch.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
+        return load_error("Error: File read mismatch.", quiet);
     }
 
     // 2. Decode
@@ -85,90 +285,781 @@ void image_viewer_open(const char *path) {
     unsigned char *data = stbi_load_from_memory(buffer, fsize, &w, &h, &n, 3); // RGB, not RGBA
     free(buffer);
 
-    if (!data) {
-        ui_draw_modal("Error: Failed to decode image.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
-    }
+    if (!data) return load_error("Error: Failed to decode image.", quiet);
     
     // Security: Validate decoded dimensions
     if (w <= 0 || h <= 0 || w > MAX_IMAGE_DIM || h > MAX_IMAGE_DIM) {
         stbi_image_free(data);
-        ui_draw_modal("Error: Image dimensions invalid.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
-    }
-
-    // 3. Allocate screen buffer (320x240 @ 16bpp = 153600 bytes)
-    int screen_w = 320;
-    int screen_h = 240;
-    uint16_t *vram = (uint16_t*)malloc(screen_w * screen_h * sizeof(uint16_t));
-    if (!vram) {
-        stbi_image_free(data);
-        ui_draw_modal("Error: VRAM alloc failed.");
-        wait_key_pressed();
-        wait_no_key_pressed();
-        return;
+        return load_error("Error: Image dimensions invalid.", quiet);
     }
     
-    // Clear to black
-    memset(vram, 0, screen_w * screen_h * sizeof(uint16_t));
+    img->data = data;
+    img->w = w;
+    img->h = h;
+    return 0;
+}
 
-    // 4. Calculate scaling (integer math)
-    int draw_w = w;
-    int draw_h = h;
+/*
+ * Screen rectangle of a w x h image fitted to the screen (never
+ * upscaled) and centered.
+ */
+static void fit_rect(int w, int h, int *start_x, int *start_y, int *draw_w, int *draw_h) {
+    // Calculate scaling (integer math)
+    int dw = w;
+    int dh = h;
     
-    if (w > screen_w || h > screen_h) {
-        int ratio_w = (screen_w * 1000) / w;
-        int ratio_h = (screen_h * 1000) / h;
+    if (w > SCREEN_W || h > SCREEN_H) {
+        int ratio_w = (SCREEN_W * 1000) / w;
+        int ratio_h = (SCREEN_H * 1000) / h;
         int ratio = (ratio_w < ratio_h) ? ratio_w : ratio_h;
         
-        draw_w = (w * ratio) / 1000;
-        draw_h = (h * ratio) / 1000;
+        dw = (w * ratio) / 1000;
+        dh = (h * ratio) / 1000;
     }
+    if (dw < 1) dw = 1;
+    if (dh < 1) dh = 1;
     
-    int start_x = (screen_w - draw_w) / 2;
-    int start_y = (screen_h - draw_h) / 2;
+    *draw_w = dw;
+    *draw_h = dh;
+    *start_x = (SCREEN_W - dw) / 2;
+    *start_y = (SCREEN_H - dh) / 2;
+}
 
-    // 5. Render to VRAM buffer
+/*
+ * Render the whole image fitted to the screen (never upscaled),
+ * nearest neighbour, centered on black. In RGB565, or in 4bpp gray
+ * on the grayscale models.
+ */
+static void render_fit(const image_t *img, uint16_t *vram) {
+    int w = img->w;
+    int h = img->h;
+    
+    // Clear to black
+    memset(vram, 0, RENDER_SIZE);
+
+    int start_x, start_y, draw_w, draw_h;
+    fit_rect(w, h, &start_x, &start_y, &draw_w, &draw_h);
+
+    // Scale one row to RGB888, then convert it
+    unsigned char row[SCREEN_W * 3];
+    int mode = color_get_dither();
+    color_diffuse_start();
     for (int y = 0; y < draw_h; y++) {
+        int src_y = (y * h) / draw_h;
+        const unsigned char *src = img->data + src_y * w * 3;
+        
+        if (gray_display) {
+            // Luminance straight from the source pixel, one byte per pixel
+            for (int x = 0; x < draw_w; x++) {
+                const unsigned char *pixel = src + ((x * w) / draw_w) * 3;
+                row[x] = COLOR_LUMA(pixel[0], pixel[1], pixel[2]);
+            }
+            color_row_gray4(row, (unsigned char *)vram + (start_y + y) * (SCREEN_W / 2),
+                            draw_w, start_x, start_y + y, mode);
+            continue;
+        }
+        
         for (int x = 0; x < draw_w; x++) {
-            int src_x = (x * w) / draw_w;
-            int src_y = (y * h) / draw_h;
-            
-            if (src_x >= w) src_x = w - 1;
-            if (src_y >= h) src_y = h - 1;
+            const unsigned char *pixel = src + ((x * w) / draw_w) * 3;
+            row[x * 3] = pixel[0];
+            row[x * 3 + 1] = pixel[1];
+            row[x * 3 + 2] = pixel[2];
+        }
+        color_row_565(row, vram + (start_y + y) * SCREEN_W + start_x, draw_w, start_x, start_y + y, mode);
+    }
+}
+
+/*
+ * Tile cache for the zoomed views. Level L is the image scaled down
+ * by 2^L; its tile (tx, ty) covers level pixels [tx*64, tx*64+64).
+ * Override TILE_BUDGET at build time to trade memory for fewer
+ * rebuilds while panning.
+ */
+#define TILE_SIZE 64
+#ifndef TILE_BUDGET
+#define TILE_BUDGET (512 * 1024)
+#endif
+#define TILE_SLOTS (TILE_BUDGET / (TILE_SIZE * TILE_SIZE * (int)sizeof(uint16_t)))
+
+typedef struct {
+    short level;    // -1 = empty slot
+    short tx, ty;
+    unsigned int stamp; // Last use, for LRU eviction
+    uint16_t px[TILE_SIZE * TILE_SIZE];
+} tile_t;
+
+typedef struct {
+    tile_t *tiles;
+    unsigned int clock;
+} tile_cache_t;
+
+/*
+ * Size of the image at a level, rounded up.
+ */
+static int level_size(int size, int level) {
+    return (size + (1 << level) - 1) >> level;
+}
+
+/*
+ * Convert one tile of a level from the decoded image, one RGB888
+ * row at a time. Pixels past the edge of the image are black.
+ * Tiles are built out of order, so error diffusion is replaced by
+ * the ordered pattern (aligned on level coordinates, no seams).
+ */
+static void tile_build(const image_t *img, int level, int tx, int ty, uint16_t *px) {
+    int lw = level_size(img->w, level);
+    int lh = level_size(img->h, level);
+    int block = 1 << level;
+    unsigned char row[TILE_SIZE * 3];
+    int mode = color_get_dither();
+    if (mode == COLOR_DITHER_DIFFUSE) mode = COLOR_DITHER_ORDERED;
+    
+    memset(px, 0, TILE_SIZE * TILE_SIZE * sizeof(uint16_t));
+    for (int j = 0; j < TILE_SIZE; j++) {
+        int y = ty * TILE_SIZE + j;
+        if (y >= lh) break;
+        int y0 = y << level;
+        int y1 = (y0 + block < img->h) ? y0 + block : img->h;
+        
+        int n = 0;
+        for (int x = tx * TILE_SIZE; n < TILE_SIZE && x < lw; n++, x++) {
+            int x0 = x << level;
+            int x1 = (x0 + block < img->w) ? x0 + block : img->w;
+            box_average(img->data, img->w, x0, x1, y0, y1, row + n * 3);
+        }
+        color_row_565(row, px + j * TILE_SIZE, n, tx * TILE_SIZE, y, mode);
+    }
+}
 
-            unsigned char *pixel = data + (src_y * w + src_x) * 3; // RGB
+/*
+ * Look up a tile, building it into the least recently used slot
+ * if it is not cached.
+ */
+static const uint16_t *tile_get(tile_cache_t *c, const image_t *img, int level, int tx, int ty) {
+    tile_t *victim = NULL;
+    c->clock++;
+    
+    for (int i = 0; i < TILE_SLOTS; i++) {
+        tile_t *t = &c->tiles[i];
+        if (t->level == level && t->tx == tx && t->ty == ty) {
+            t->stamp = c->clock;
+            return t->px;
+        }
+        // Prefer an empty slot, then the oldest one
+        if (!victim || (victim->level >= 0 && (t->level < 0 || t->stamp < victim->stamp))) {
+            victim = t;
+        }
+    }
+    
+    tile_build(img, level, tx, ty, victim->px);
+    victim->level = level;
+    victim->tx = tx;
+    victim->ty = ty;
+    victim->stamp = c->clock;
+    return victim->px;
+}
+
+/*
+ * Render a level with its pixel (ox, oy) at the top-left corner of
+ * the screen. Negative origins center images smaller than the screen.
+ */
+static void render_tiles(tile_cache_t *c, const image_t *img, int level, int ox, int oy, uint16_t *vram) {
+    int lw = level_size(img->w, level);
+    int lh = level_size(img->h, level);
+    
+    memset(vram, 0, SCREEN_W * SCREEN_H * sizeof(uint16_t));
+    
+    int x_end = (ox + SCREEN_W < lw) ? ox + SCREEN_W : lw;
+    int y_end = (oy + SCREEN_H < lh) ? oy + SCREEN_H : lh;
+    int x_start = ox > 0 ? ox : 0;
+    int y_start = oy > 0 ? oy : 0;
+    
+    for (int ty = y_start / TILE_SIZE; ty * TILE_SIZE < y_end; ty++) {
+        for (int tx = x_start / TILE_SIZE; tx * TILE_SIZE < x_end; tx++) {
+            const uint16_t *px = tile_get(c, img, level, tx, ty);
+            
+            // Part of the tile that is on screen
+            int x0 = tx * TILE_SIZE > x_start ? tx * TILE_SIZE : x_start;
+            int x1 = (tx + 1) * TILE_SIZE < x_end ? (tx + 1) * TILE_SIZE : x_end;
+            int y0 = ty * TILE_SIZE > y_start ? ty * TILE_SIZE : y_start;
+            int y1 = (ty + 1) * TILE_SIZE < y_end ? (ty + 1) * TILE_SIZE : y_end;
             
-            // RGB565: RRRRR GGGGGG BBBBB
-            uint16_t color = ((pixel[0] & 0xF8) << 8) | ((pixel[1] & 0xFC) << 3) | (pixel[2] >> 3);
+            for (int y = y0; y < y1; y++) {
+                memcpy(vram + (y - oy) * SCREEN_W + (x0 - ox),
+                       px + (y - ty * TILE_SIZE) * TILE_SIZE + (x0 - tx * TILE_SIZE),
+                       (x1 - x0) * sizeof(uint16_t));
+            }
+        }
+    }
+}
+
+/*
+ * Top-left origin of the screen at a level for a view centered on
+ * (cx, cy) in image pixels, clamped to the image edges.
+ */
+static int view_origin(int center, int size, int level, int screen) {
+    int lsize = level_size(size, level);
+    if (lsize <= screen) return -(screen - lsize) / 2;
+    
+    int o = (center >> level) - screen / 2;
+    if (o < 0) o = 0;
+    if (o > lsize - screen) o = lsize - screen;
+    return o;
+}
+
+#define ZOOM_FIT -1
+
+// What ended the view of one image
+#define VIEW_EXIT 0
+#define VIEW_NEXT 1
+#define VIEW_PREV 2
+
+/*
+ * Background pre-decode of the neighbouring image: decoded and
+ * fitted to the screen while the current image is on display.
+ */
+typedef struct {
+    file_list_t *list;
+    int index;      // Entry to pre-decode, -1 for none
+    int ready;      // vram holds its fitted render
+    uint16_t *vram;
+} prefetch_t;
+
+/*
+ * Full path of a list entry.
+ */
+static void entry_path(file_list_t *list, int index, char *buf, size_t size) {
+    if (strcmp(list->path, "/") == 0)
+        snprintf(buf, size, "/%s", list->entries[index].name);
+    else
+        snprintf(buf, size, "%s/%s", list->path, list->entries[index].name);
+}
+
+/*
+ * Next image entry from `from` in direction dir (+1/-1), or -1.
+ */
+static int find_image(file_list_t *list, int from, int dir) {
+    if (!list) return -1;
+    for (int i = from + dir; i >= 0 && i < list->count; i += dir) {
+        if (!list->entries[i].is_dir && image_viewer_is_image(list->entries[i].name)) return i;
+    }
+    return -1;
+}
+
+/*
+ * Do the pending pre-decode, if any. Returns 1 if work was done.
+ */
+static int prefetch_step(prefetch_t *pre) {
+    if (!pre || !pre->vram || pre->index < 0 || pre->ready) return 0;
+    
+    char path[1024];
+    image_t img;
+    entry_path(pre->list, pre->index, path, sizeof(path));
+    if (render_cache_get(path, pre->vram, RENDER_SIZE) != 0) {
+        if (image_load(path, &img, 1) != 0) {
+            pre->index = -1;
+            return 1;
+        }
+        render_fit(&img, pre->vram);
+        render_cache_put(path, pre->vram, RENDER_SIZE);
+        stbi_image_free(img.data);
+    }
+    pre->ready = 1;
+    return 1;
+}
+
+/*
+ * Show one image until the user leaves it. vram holds the fitted
+ * render on entry; img->data may be NULL if the image came from the
+ * pre-decode, in which case it is decoded when first zoomed.
+ * Pre-decoding runs while no key is pressed.
+ * Returns VIEW_EXIT, VIEW_NEXT or VIEW_PREV.
+ */
+static int image_view(const char *path, image_t *img, uint16_t *vram, prefetch_t *pre,
+                      int can_prev, int can_next) {
+    tile_cache_t cache = { NULL, 0 };
+    int zoom = ZOOM_FIT;
+    int fit_level = -1; // Known once decoded
+    int cx = 0, cy = 0;
+    int result = VIEW_EXIT;
+    int redraw = 1;
+    int refit = 0;  // vram holds a zoomed view
+    
+    while (1) {
+        if (redraw) {
+            if (zoom != ZOOM_FIT) {
+                render_tiles(&cache, img, zoom,
+                             view_origin(cx, img->w, zoom, SCREEN_W),
+                             view_origin(cy, img->h, zoom, SCREEN_H), vram);
+                if (gray_display) {
+                    color_565_to_gray4(vram, (unsigned char *)vram, SCREEN_W, SCREEN_H, color_get_dither());
+                }
+                refit = 1;
+            } else if (refit) {
+                render_fit(img, vram);
+                render_cache_put(path, vram, RENDER_SIZE);
+                refit = 0;
+            }
+            blit(vram);
+        }
+        redraw = 1;
+        
+        // Use the time between key presses to pre-decode
+        int k;
+        while (!(k = input_poll_key())) {
+            if (!prefetch_step(pre)) idle();
+        }
+        
+        if (k == NIO_KEY_ESC || k == 'q' || k == NIO_KEY_ENTER || k == NIO_KEY_BACKSPACE) {
+            break;
+        } else if (zoom == ZOOM_FIT && k == NIO_KEY_RIGHT && can_next) {
+            result = VIEW_NEXT;
+            break;
+        } else if (zoom == ZOOM_FIT && k == NIO_KEY_LEFT && can_prev) {
+            result = VIEW_PREV;
+            break;
+        } else if (k == '+' && zoom != 0) {
+            if (!img->data && image_load(path, img, 0) != 0) break;
+            if (fit_level < 0) {
+                // Smallest level that fits the screen; below it zooming shows more
+                fit_level = 0;
+                while (level_size(img->w, fit_level) > SCREEN_W || level_size(img->h, fit_level) > SCREEN_H) {
+                    fit_level++;
+                }
+                cx = img->w / 2;
+                cy = img->h / 2;
+            }
+            if (fit_level == 0) {
+                redraw = 0; // Already shown at 1:1
+                continue;
+            }
             
-            int screen_x = start_x + x;
-            int screen_y = start_y + y;
+            // Tiles are only needed once the view is zoomed in
+            if (!cache.tiles) {
+                cache.tiles = malloc(TILE_SLOTS * sizeof(tile_t));
+                if (!cache.tiles) {
+                    redraw = 0;
+                    continue;
+                }
+                for (int i = 0; i < TILE_SLOTS; i++) cache.tiles[i].level = -1;
+            }
+            zoom = (zoom == ZOOM_FIT) ? fit_level - 1 : zoom - 1;
+        } else if (k == 'd' || k == 'D') {
+            // Next dithering mode: cached renders and tiles are stale
+            if (!img->data && image_load(path, img, 0) != 0) break;
+            color_set_dither((color_get_dither() + 1) % COLOR_DITHER_COUNT);
+            render_cache_clear();
+            if (cache.tiles) {
+                for (int i = 0; i < TILE_SLOTS; i++) cache.tiles[i].level = -1;
+            }
+            if (pre) pre->ready = 0;
+            refit = 1;
+        } else if (k == '-' && zoom != ZOOM_FIT) {
+            zoom++;
+            if (zoom >= fit_level) zoom = ZOOM_FIT;
+        } else if (zoom != ZOOM_FIT) {
+            // Pan by a quarter screen
+            if (k == NIO_KEY_LEFT) cx -= (SCREEN_W / 4) << zoom;
+            else if (k == NIO_KEY_RIGHT) cx += (SCREEN_W / 4) << zoom;
+            else if (k == NIO_KEY_UP) cy -= (SCREEN_H / 4) << zoom;
+            else if (k == NIO_KEY_DOWN) cy += (SCREEN_H / 4) << zoom;
             
-            if (screen_x >= 0 && screen_x < screen_w && screen_y >= 0 && screen_y < screen_h) {
-                vram[screen_y * screen_w + screen_x] = color;
+            // Keep the center where the view can reach
+            int half_w = (SCREEN_W / 2) << zoom;
+            int half_h = (SCREEN_H / 2) << zoom;
+            if (cx > img->w - half_w) cx = img->w - half_w;
+            if (cx < half_w) cx = half_w;
+            if (cy > img->h - half_h) cy = img->h - half_h;
+            if (cy < half_h) cy = half_h;
+        } else {
+            redraw = 0; // Nothing changed
+        }
+    }
+    
+    free(cache.tiles);
+    return result;
+}
+
+/*
+ * Put the fitted render of path in vram: from the decoded-image
+ * cache if possible (img->data stays NULL), else by decoding.
+ * Returns 0 on success, -1 on failure (already reported).
+ */
+static int image_show(const char *path, image_t *img, uint16_t *vram) {
+    img->data = NULL;
+    if (render_cache_get(path, vram, RENDER_SIZE) == 0) return 0;
+    
+    if (image_load(path, img, 0) != 0) return -1;
+    render_fit(img, vram);
+    render_cache_put(path, vram, RENDER_SIZE);
+    return 0;
+}
+
+/*
+ * Animated GIF playback
+ *
+ * Frames are decoded one at a time from the file (stb_image's
+ * frame-by-frame GIF decoder, fed through file_callbacks) instead of
+ * stbi_load_gif_from_memory, which keeps every frame. The decoder
+ * composes each frame onto its RGBA canvas; only the part that
+ * changed (this frame's rectangle plus the previous one, which its
+ * disposal may have restored) is scaled into the screen buffer.
+ * Frames use the ordered pattern whatever the dithering mode: it can
+ * convert a sub-rectangle and does not shimmer from frame to frame.
+ *
+ * Delays are honoured with msleep while polling the keyboard. The
+ * only clock is the RTC, so the achieved frame rate is measured per
+ * RTC second and the time spent decoding a frame (one second's
+ * measurement) is taken off the next delays.
+ */
+#define GIF_MIN_DELAY 20     // Shorter delays mean "as fast as possible": use the default
+#define GIF_DEFAULT_DELAY 100
+#define GIF_POLL_MS 10       // Keyboard polling interval while waiting
+
+#ifndef GIF_RTC_SECONDS
+#define GIF_RTC_SECONDS() (*(volatile unsigned *)0x90090000)
+#endif
+
+typedef struct {
+    FILE *f;
+    stbi__context s;
+    stbi__gif g;        // Decoder state and composed canvas
+    int frames;         // Frames decoded in the current loop
+    int prev_x0, prev_y0, prev_x1, prev_y1; // Previous frame rectangle
+    // Frame rate, measured over whole RTC seconds
+    unsigned int second;
+    int window_frames;
+    int window_slept;
+    int fps10;          // Achieved frames per second x 10, -1 = not measured yet
+    int overhead;       // Estimated ms per frame spent outside msleep
+} gif_anim_t;
+
+/*
+ * Drop the decoder state and restart at the beginning of the file.
+ */
+static void gif_rewind(gif_anim_t *a) {
+    STBI_FREE(a->g.out);
+    STBI_FREE(a->g.background);
+    STBI_FREE(a->g.history);
+    memset(&a->g, 0, sizeof(a->g));
+    fseek(a->f, 0, SEEK_SET);
+    stbi__start_callbacks(&a->s, (stbi_io_callbacks *)&file_callbacks, a->f);
+    a->frames = 0;
+}
+
+/*
+ * Decode the next frame onto the canvas.
+ * Returns 0 for a frame, 1 at the end of the stream, -1 on error.
+ */
+static int gif_next(gif_anim_t *a) {
+    int comp;
+    // No frame to revert to: "restore previous" disposes to the background
+    stbi_uc *u = stbi__gif_load_next(&a->s, &a->g, &comp, 4, NULL);
+    if (u == (stbi_uc *)&a->s) return 1;
+    if (!u) return -1;
+    a->frames++;
+    return 0;
+}
+
+/*
+ * Scale the canvas rectangle [x0,x1) x [y0,y1) (image pixels) into
+ * its place in the fitted screen render.
+ */
+static void gif_render(const gif_anim_t *a, uint16_t *vram, int x0, int y0, int x1, int y1) {
+    int w = a->g.w, h = a->g.h;
+    int start_x, start_y, draw_w, draw_h;
+    fit_rect(w, h, &start_x, &start_y, &draw_w, &draw_h);
+    
+    // Screen columns whose source column falls inside the rectangle
+    int dx0 = (x0 * draw_w + w - 1) / w;
+    int dx1 = (x1 * draw_w + w - 1) / w;
+    if (dx1 > draw_w) dx1 = draw_w;
+    if (dx0 >= dx1) return;
+    
+    unsigned char row[SCREEN_W * 3];
+    int mode = color_get_dither();
+    if (mode == COLOR_DITHER_DIFFUSE) mode = COLOR_DITHER_ORDERED;
+    
+    for (int y = 0; y < draw_h; y++) {
+        int src_y = (y * h) / draw_h;
+        if (src_y < y0) continue;
+        if (src_y >= y1) break;
+        const unsigned char *src = a->g.out + src_y * w * 4;
+        int n = dx1 - dx0;
+        
+        // Transparent pixels were never drawn and stay black
+        for (int x = dx0; x < dx1; x++) {
+            const unsigned char *pixel = src + ((x * w) / draw_w) * 4;
+            if (gray_display) {
+                row[x - dx0] = COLOR_LUMA(pixel[0], pixel[1], pixel[2]);
+            } else {
+                row[(x - dx0) * 3] = pixel[0];
+                row[(x - dx0) * 3 + 1] = pixel[1];
+                row[(x - dx0) * 3 + 2] = pixel[2];
             }
         }
+        if (gray_display) {
+            color_row_gray4(row, (unsigned char *)vram + (start_y + y) * (SCREEN_W / 2),
+                            n, start_x + dx0, start_y + y, mode);
+        } else {
+            color_row_565(row, vram + (start_y + y) * SCREEN_W + start_x + dx0, n,
+                          start_x + dx0, start_y + y, mode);
+        }
     }
+}
+
+/*
+ * Render the part of the screen the last decoded frame changed.
+ */
+static void gif_render_frame(gif_anim_t *a, uint16_t *vram) {
+    stbi__gif *g = &a->g;
+    int x0 = g->start_x / 4;
+    int x1 = g->max_x / 4;
+    int y0 = g->start_y / g->line_size;
+    int y1 = g->max_y / g->line_size;
     
-    stbi_image_free(data);
+    if (a->frames == 1) {
+        // Pixels outside the first frame got the background color
+        gif_render(a, vram, 0, 0, g->w, g->h);
+    } else {
+        gif_render(a, vram,
+                   x0 < a->prev_x0 ? x0 : a->prev_x0, y0 < a->prev_y0 ? y0 : a->prev_y0,
+                   x1 > a->prev_x1 ? x1 : a->prev_x1, y1 > a->prev_y1 ? y1 : a->prev_y1);
+    }
+    a->prev_x0 = x0;
+    a->prev_y0 = y0;
+    a->prev_x1 = x1;
+    a->prev_y1 = y1;
+}
 
-    // 6. Blit to LCD
-    lcd_blit(vram, SCR_320x240_565);
+/*
+ * Count a displayed frame, and at each RTC second update the
+ * achieved frame rate and the per-frame overhead estimate.
+ */
+static void gif_tick(gif_anim_t *a, int slept) {
+    unsigned int now = GIF_RTC_SECONDS();
+    a->window_frames++;
+    a->window_slept += slept;
+    if (now == a->second) return;
+    
+    // The first window started mid-second: only use full ones
+    if (a->second && a->window_frames > 0) {
+        int ms = (int)(now - a->second) * 1000;
+        a->fps10 = a->window_frames * 10000 / ms;
+        a->overhead = (ms - a->window_slept) / a->window_frames;
+        if (a->overhead < 0) a->overhead = 0;
+    }
+    a->second = now;
+    a->window_frames = 0;
+    a->window_slept = 0;
+}
 
-    // 7. Wait for exit
+/*
+ * Play a GIF until the user leaves it. Single-frame GIFs are simply
+ * shown. Returns VIEW_EXIT, VIEW_NEXT or VIEW_PREV.
+ */
+static int gif_play(const char *path, uint16_t *vram, int can_prev, int can_next) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        load_error("Error: Could not open file.", 0);
+        return VIEW_EXIT;
+    }
+    
+    // Reject oversized canvases before the decoder allocates them
+    int w, h, n;
+    if (!stbi_info_from_callbacks(&file_callbacks, f, &w, &h, &n) ||
+        w <= 0 || h <= 0 || w > MAX_IMAGE_DIM || h > MAX_IMAGE_DIM) {
+        fclose(f);
+        load_error("Error: Image dimensions invalid.", 0);
+        return VIEW_EXIT;
+    }
+    
+    // The decoder state holds the 8192-entry LZW table: keep it off the stack
+    gif_anim_t *a = (gif_anim_t *)calloc(1, sizeof(gif_anim_t));
+    if (!a) {
+        fclose(f);
+        load_error("Error: Out of memory.", 0);
+        return VIEW_EXIT;
+    }
+    a->f = f;
+    a->fps10 = -1;
+    gif_rewind(a);
+    
+    int result = VIEW_EXIT;
+    int still = 0; // Single frame: nothing to animate
+    memset(vram, 0, RENDER_SIZE);
+    
     while (1) {
-        int k = input_get_key();
+        if (!still) {
+            int status = gif_next(a);
+            if (status == 1) {
+                if (a->frames <= 1) {
+                    still = 1;
+                } else {
+                    gif_rewind(a);
+                    status = gif_next(a);
+                }
+            }
+            if (status < 0) {
+                load_error("Error: Failed to decode image.", 0);
+                break;
+            }
+            if (status == 0) {
+                gif_render_frame(a, vram);
+                blit(vram);
+            }
+        }
+        
+        // Wait out the frame delay, minus the time the next frame takes
+        int delay = a->g.delay < GIF_MIN_DELAY ? GIF_DEFAULT_DELAY : a->g.delay;
+        int wait = delay - a->overhead;
+        int slept = 0;
+        int k;
+        if (still) {
+            k = input_get_key();
+        } else {
+            while (!(k = input_poll_key()) && slept < wait) {
+                msleep(GIF_POLL_MS);
+                slept += GIF_POLL_MS;
+            }
+            gif_tick(a, slept);
+        }
+        if (!k) continue;
+        
         if (k == NIO_KEY_ESC || k == 'q' || k == NIO_KEY_ENTER || k == NIO_KEY_BACKSPACE) {
             break;
+        } else if (k == NIO_KEY_RIGHT && can_next) {
+            result = VIEW_NEXT;
+            break;
+        } else if (k == NIO_KEY_LEFT && can_prev) {
+            result = VIEW_PREV;
+            break;
+        } else if (k == 'i' || k == 'I') {
+            // Playback info; the modal pauses the animation
+            char msg[64];
+            if (a->fps10 < 0)
+                snprintf(msg, sizeof(msg), "%dx%d, frame %d", a->g.w, a->g.h, a->frames);
+            else
+                snprintf(msg, sizeof(msg), "%dx%d, frame %d, %d.%d fps", a->g.w, a->g.h,
+                         a->frames, a->fps10 / 10, a->fps10 % 10);
+            ui_draw_modal(msg);
+            wait_key_pressed();
+            wait_no_key_pressed();
+            a->second = 0; // The pause must not count
+            a->window_frames = 0;
+            a->window_slept = 0;
+            blit(vram);
         }
     }
+    
+    STBI_FREE(a->g.out);
+    STBI_FREE(a->g.background);
+    STBI_FREE(a->g.history);
+    fclose(a->f);
+    free(a);
+    return result;
+}
+
+/*
+ * Returns 1 if the file name is a GIF (played rather than viewed).
+ */
+static int is_gif(const char *name) {
+    const char *format = image_viewer_format(name);
+    return format && strcmp(format, "GIF") == 0;
+}
+
+void image_viewer_open(const char *path) {
+    detect_display();
+    
+    // Allocate screen buffer (320x240 @ 16bpp = 153600 bytes)
+    uint16_t *vram = (uint16_t*)malloc(COLOR_BYTES);
+    if (!vram) {
+        ui_draw_modal("Error: VRAM alloc failed.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    
+    image_t img = { NULL, 0, 0 };
+    if (is_gif(path)) {
+        gif_play(path, vram, 0, 0);
+    } else if (image_show(path, &img, vram) == 0) {
+        image_view(path, &img, vram, NULL, 0, 0);
+    }
+    
+    free(vram);
+    stbi_image_free(img.data);
+    
+    // Restore NIO display
+    nio_fflush(nio_get_default());
+}
+
+int image_viewer_browse(file_list_t *list, int index) {
+    detect_display();
+    
+    // Screen buffer plus one for the pre-decoded neighbour (they are
+    // swapped, so both must hold a zoomed RGB565 view)
+    uint16_t *vram = (uint16_t*)malloc(COLOR_BYTES);
+    if (!vram) {
+        ui_draw_modal("Error: VRAM alloc failed.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return index;
+    }
+    prefetch_t pre = { list, -1, 0, malloc(COLOR_BYTES) };
+    
+    int dir = 1;
+    int shown = index; // The entry to leave the list on
+    while (1) {
+        char path[1024];
+        entry_path(list, index, path, sizeof(path));
+        int prev = find_image(list, index, -1);
+        int next = find_image(list, index, 1);
+        int action;
+        
+        if (is_gif(path)) {
+            // Played straight from the file, using the idle time itself
+            pre.index = -1;
+            action = gif_play(path, vram, prev >= 0, next >= 0);
+        } else {
+            image_t img = { NULL, 0, 0 };
+            if (pre.index == index && pre.ready) {
+                // Already decoded in the background: swap buffers
+                uint16_t *tmp = vram;
+                vram = pre.vram;
+                pre.vram = tmp;
+            } else if (image_show(path, &img, vram) != 0) {
+                // Reported already: skip it in the direction of travel
+                index = find_image(list, index, dir);
+                if (index < 0) break;
+                continue;
+            }
+            
+            // Queue the neighbour in the direction of travel (GIFs are played, not pre-decoded)
+            pre.index = (dir > 0) ? next : prev;
+            if (pre.index >= 0 && is_gif(list->entries[pre.index].name)) pre.index = -1;
+            pre.ready = 0;
+            
+            action = image_view(path, &img, vram, &pre, prev >= 0, next >= 0);
+            stbi_image_free(img.data);
+        }
+        shown = index;
+        
+        if (action == VIEW_NEXT) {
+            index = next;
+            dir = 1;
+        } else if (action == VIEW_PREV) {
+            index = prev;
+            dir = -1;
+        } else {
+            break;
+        }
+    }
+    
+    free(pre.vram);
     free(vram);
     
     // Restore NIO display
     nio_fflush(nio_get_default());
+    return shown;
 }
@@ -1,6 +1,20 @@
 #ifndef IMAGE_VIEWER_H
 #define IMAGE_VIEWER_H
 
+#include <stdint.h>
+#include "fs.h"
+
 void image_viewer_open(const char *path);
 
+// View list entry index with next/previous navigation over the
+// images of the list. Returns the index of the last image shown.
+int image_viewer_browse(file_list_t *list, int index);
+int image_viewer_is_image(const char *name);
+
+// Decoder that handles a file name ("PNG", "JPEG", ...) or NULL
+const char *image_viewer_format(const char *name);
+
+// Decode into a tw x th RGB565 thumbnail. Returns 0 or -1.
+int image_decode_thumbnail(const char *path, uint16_t *out, int tw, int th);
+
 #endif
@@ -0,0 +1,343 @@
+/*
+ * Streaming inflate
+ *
+ * Raw DEFLATE (RFC 1951) decoder working from a read callback to a
+ * write callback, for archive members that must not be loaded
+ * whole. stb_image carries a zlib decoder too, but it only decodes
+ * complete buffers in memory.
+ *
+ * Output goes through the 32 KB window the format requires and is
+ * handed to the writer each time the window fills, so memory use is
+ * fixed. Huffman symbols are decoded like stb_image does: a 9-bit
+ * lookup table resolves the common short codes in one step and
+ * longer ones fall back to a canonical search.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "inflate.h"
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define INPUT_SIZE 4096
+#define FAST_BITS 9
+#define FAST_MASK ((1 << FAST_BITS) - 1)
+#define MAX_BITS 15
+
+typedef struct {
+    uint16_t fast[1 << FAST_BITS]; // (length << 9) | symbol, 0 = longer code
+    uint16_t first_code[MAX_BITS + 2];
+    uint16_t first_symbol[MAX_BITS + 2];
+    int max_code[MAX_BITS + 2];    // First code past each length, left-aligned to 16 bits
+    uint8_t size[288];
+    uint16_t value[288];
+} huffman_t;
+
+typedef struct {
+    inflate_read_fn read;
+    void *read_user;
+    inflate_write_fn write;
+    void *write_user;
+    int error;
+
+    // Input and bit buffer. Past the end of the input the bit buffer
+    // is padded with zeros; consuming padding means a truncated stream.
+    unsigned char in[INPUT_SIZE];
+    int in_pos, in_len, in_eof;
+    uint32_t bits;
+    int num_bits;
+    int pad_bits;
+
+    // Output window
+    unsigned char window[WINDOW_SIZE];
+    int pos;
+    unsigned long total;
+
+    huffman_t lit, dist;
+} inflate_t;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void fail(inflate_t *s, int error) {
+    if (!s->error) s->error = error;
+}
+
+static int bit_reverse(int v, int bits) {
+    int r = 0;
+    for (int i = 0; i < bits; i++, v >>= 1) r = (r << 1) | (v & 1);
+    return r;
+}
+
+/*
+ * Build the decoding tables of a canonical code from its code
+ * lengths. Returns 0, or -1 if the lengths are oversubscribed.
+ */
+static int build_huffman(huffman_t *h, const uint8_t *lengths, int num) {
+    int count[MAX_BITS + 1] = { 0 };
+    int next_code[MAX_BITS + 1];
+
+    for (int i = 0; i < (1 << FAST_BITS); i++) h->fast[i] = 0;
+    for (int i = 0; i < num; i++) count[lengths[i]]++;
+    count[0] = 0;
+
+    int code = 0, k = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        next_code[len] = code;
+        h->first_code[len] = code;
+        h->first_symbol[len] = k;
+        code += count[len];
+        if (count[len] && code - 1 >= (1 << len)) return -1;
+        h->max_code[len] = code << (16 - len);
+        code <<= 1;
+        k += count[len];
+    }
+    h->max_code[MAX_BITS + 1] = 0x10000;
+
+    for (int i = 0; i < num; i++) {
+        int len = lengths[i];
+        if (!len) continue;
+        int c = next_code[len] - h->first_code[len] + h->first_symbol[len];
+        h->size[c] = len;
+        h->value[c] = i;
+        if (len <= FAST_BITS) {
+            // Every table index whose low bits are this (reversed) code
+            for (int j = bit_reverse(next_code[len], len); j < (1 << FAST_BITS); j += 1 << len) {
+                h->fast[j] = (len << 9) | i;
+            }
+        }
+        next_code[len]++;
+    }
+    return 0;
+}
+
+static int next_byte(inflate_t *s) {
+    if (s->in_pos == s->in_len) {
+        if (s->in_eof) return -1;
+        int n = s->read(s->read_user, s->in, INPUT_SIZE);
+        if (n <= 0) {
+            if (n < 0) fail(s, INFLATE_ERR_IO);
+            s->in_eof = 1;
+            return -1;
+        }
+        s->in_pos = 0;
+        s->in_len = n;
+    }
+    return s->in[s->in_pos++];
+}
+
+static void fill(inflate_t *s, int n) {
+    while (s->num_bits < n) {
+        int b = next_byte(s);
+        if (b < 0) {
+            b = 0;
+            s->pad_bits += 8;
+        }
+        s->bits |= (uint32_t)b << s->num_bits;
+        s->num_bits += 8;
+    }
+}
+
+static void drop(inflate_t *s, int n) {
+    if (n > s->num_bits - s->pad_bits) {
+        fail(s, INFLATE_ERR_DATA); // Ran past the end of the input
+        s->bits = 0;
+        s->num_bits = s->pad_bits = 0;
+        return;
+    }
+    s->bits >>= n;
+    s->num_bits -= n;
+}
+
+static int get_bits(inflate_t *s, int n) {
+    if (!n) return 0;
+    fill(s, n);
+    int v = s->bits & ((1u << n) - 1);
+    drop(s, n);
+    return v;
+}
+
+static int decode(inflate_t *s, const huffman_t *h) {
+    fill(s, 16);
+    int b = h->fast[s->bits & FAST_MASK];
+    if (b) {
+        drop(s, b >> 9);
+        return b & 511;
+    }
+
+    // Longer than FAST_BITS: compare the code, MSB first, with each length's range
+    int k = bit_reverse(s->bits & 0xFFFF, 16);
+    int len;
+    for (len = FAST_BITS + 1; k >= h->max_code[len]; len++) {}
+    if (len > MAX_BITS) {
+        fail(s, INFLATE_ERR_DATA);
+        return -1;
+    }
+    int c = (k >> (16 - len)) - h->first_code[len] + h->first_symbol[len];
+    if (c >= 288 || h->size[c] != len) {
+        fail(s, INFLATE_ERR_DATA);
+        return -1;
+    }
+    drop(s, len);
+    return h->value[c];
+}
+
+static void put(inflate_t *s, unsigned char c) {
+    s->window[s->pos++] = c;
+    s->total++;
+    if (s->pos == WINDOW_SIZE) {
+        if (s->write(s->write_user, s->window, WINDOW_SIZE) != 0) fail(s, INFLATE_ERR_IO);
+        s->pos = 0;
+    }
+}
+
+static void stored_block(inflate_t *s) {
+    drop(s, s->num_bits & 7); // To the byte boundary
+    int len = get_bits(s, 16);
+    int nlen = get_bits(s, 16);
+    if (len != (~nlen & 0xFFFF)) {
+        fail(s, INFLATE_ERR_DATA);
+        return;
+    }
+
+    // Whole bytes left in the bit buffer first, then straight from the input
+    while (len > 0 && s->num_bits > 0 && !s->error) {
+        put(s, get_bits(s, 8));
+        len--;
+    }
+    while (len > 0 && !s->error) {
+        int b = next_byte(s);
+        if (b < 0) {
+            fail(s, INFLATE_ERR_DATA);
+            return;
+        }
+        put(s, b);
+        len--;
+    }
+}
+
+static void fixed_tables(inflate_t *s) {
+    uint8_t lengths[288];
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    build_huffman(&s->lit, lengths, 288);
+    for (i = 0; i < 32; i++) lengths[i] = 5;
+    build_huffman(&s->dist, lengths, 32);
+}
+
+static void dynamic_tables(inflate_t *s) {
+    static const uint8_t order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    int hlit = get_bits(s, 5) + 257;
+    int hdist = get_bits(s, 5) + 1;
+    int hclen = get_bits(s, 4) + 4;
+
+    // The code-length code is only needed here: build it in dist
+    uint8_t lengths[286 + 32] = { 0 };
+    for (int i = 0; i < hclen; i++) lengths[order[i]] = get_bits(s, 3);
+    if (build_huffman(&s->dist, lengths, 19) != 0) {
+        fail(s, INFLATE_ERR_DATA);
+        return;
+    }
+
+    int n = 0;
+    while (n < hlit + hdist && !s->error) {
+        int c = decode(s, &s->dist);
+        int repeat, value = 0;
+        if (c < 0) return;
+        if (c < 16) {
+            lengths[n++] = c;
+            continue;
+        } else if (c == 16) {
+            if (n == 0) break;
+            value = lengths[n - 1];
+            repeat = 3 + get_bits(s, 2);
+        } else if (c == 17) {
+            repeat = 3 + get_bits(s, 3);
+        } else {
+            repeat = 11 + get_bits(s, 7);
+        }
+        if (n + repeat > hlit + hdist) break;
+        while (repeat--) lengths[n++] = value;
+    }
+    if (n != hlit + hdist ||
+        build_huffman(&s->lit, lengths, hlit) != 0 ||
+        build_huffman(&s->dist, lengths + hlit, hdist) != 0) {
+        fail(s, INFLATE_ERR_DATA);
+    }
+}
+
+static void compressed_block(inflate_t *s) {
+    while (!s->error) {
+        int sym = decode(s, &s->lit);
+        if (sym < 0) return;
+        if (sym < 256) {
+            put(s, sym);
+            continue;
+        }
+        if (sym == 256) return; // End of block
+
+        sym -= 257;
+        if (sym >= 29) break;
+        int len = length_base[sym] + get_bits(s, length_extra[sym]);
+        int d = decode(s, &s->dist);
+        if (d < 0) return;
+        if (d >= 30) break;
+        int dist = dist_base[d] + get_bits(s, dist_extra[d]);
+        if ((unsigned long)dist > s->total) break;
+
+        while (len--) put(s, s->window[(s->pos - dist) & WINDOW_MASK]);
+    }
+    fail(s, INFLATE_ERR_DATA);
+}
+
+int inflate_stream(inflate_read_fn read, void *read_user, inflate_write_fn write, void *write_user) {
+    inflate_t *s = calloc(1, sizeof(inflate_t));
+    if (!s) return INFLATE_ERR_MEM;
+    s->read = read;
+    s->read_user = read_user;
+    s->write = write;
+    s->write_user = write_user;
+
+    int final;
+    do {
+        final = get_bits(s, 1);
+        int type = get_bits(s, 2);
+        if (type == 0) {
+            stored_block(s);
+            continue;
+        } else if (type == 1) {
+            fixed_tables(s);
+        } else if (type == 2) {
+            dynamic_tables(s);
+        } else {
+            fail(s, INFLATE_ERR_DATA);
+        }
+        if (!s->error) compressed_block(s);
+    } while (!final && !s->error);
+
+    if (!s->error && s->pos > 0 && s->write(s->write_user, s->window, s->pos) != 0) {
+        fail(s, INFLATE_ERR_IO);
+    }
+    int result = s->error;
+    free(s);
+    return result;
+}
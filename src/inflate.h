@@ -0,0 +1,20 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+// Supply up to size bytes of compressed data. Returns the count, 0 at
+// the end of the input, -1 on a read error.
+typedef int (*inflate_read_fn)(void *user, unsigned char *buf, int size);
+
+// Consume size bytes of output. Returns 0, or -1 to abort.
+typedef int (*inflate_write_fn)(void *user, const unsigned char *buf, int size);
+
+#define INFLATE_OK 0
+#define INFLATE_ERR_DATA -1 // Corrupt or truncated stream
+#define INFLATE_ERR_IO -2   // A callback failed
+#define INFLATE_ERR_MEM -3
+
+// Decode a raw DEFLATE stream (no zlib/gzip header) from read to
+// write. Memory use is fixed (about 40 KB) whatever the data size.
+int inflate_stream(inflate_read_fn read, void *read_user, inflate_write_fn write, void *write_user);
+
+#endif
@@ -18,8 +18,42 @@ int input_get_key(void) {
     // 2. Check for keys that nspireio might ignore or that we want to override
     // Priority: Menu/Ctrl -> Left/Right -> Enter
     
-    // MENU / CTRL
-    if (isKeyPressed(KEY_NSPIRE_MENU) || isKeyPressed(KEY_NSPIRE_CTRL)) {
+    // MENU
+    if (isKeyPressed(KEY_NSPIRE_MENU)) {
+        wait_no_key_pressed();
+        return NIO_KEY_MENU;
+    }
+    
+    // CTRL: held together with a letter it is a shortcut,
+    // released on its own it acts as Menu
+    if (isKeyPressed(KEY_NSPIRE_CTRL)) {
+        while (isKeyPressed(KEY_NSPIRE_CTRL)) {
+            if (isKeyPressed(KEY_NSPIRE_Z)) {
+                wait_no_key_pressed();
+                return NIO_KEY_UNDO;
+            }
+            if (isKeyPressed(KEY_NSPIRE_Y)) {
+                wait_no_key_pressed();
+                return NIO_KEY_REDO;
+            }
+            if (isKeyPressed(KEY_NSPIRE_F)) {
+                wait_no_key_pressed();
+                return NIO_KEY_FIND;
+            }
+            if (isKeyPressed(KEY_NSPIRE_G)) {
+                wait_no_key_pressed();
+                return NIO_KEY_FIND_NEXT;
+            }
+            if (isKeyPressed(KEY_NSPIRE_R)) {
+                wait_no_key_pressed();
+                return NIO_KEY_REPLACE;
+            }
+            if (isKeyPressed(KEY_NSPIRE_W)) {
+                wait_no_key_pressed();
+                return NIO_KEY_WRAP;
+            }
+            idle();
+        }
         wait_no_key_pressed();
         return NIO_KEY_MENU;
     }
@@ -55,3 +89,13 @@ int input_get_key(void) {
     
     return c;
 }
+
+/*
+ * Non-blocking variant of input_get_key.
+ * Returns 0 immediately when no key is down, so callers can use
+ * the time between key presses for background work.
+ */
+int input_poll_key(void) {
+    if (!any_key_pressed()) return 0;
+    return input_get_key();
+}
@@ -6,7 +6,19 @@
 #define NIO_KEY_RIGHT 0x84
 #define NIO_KEY_MENU  0x85
 #define NIO_KEY_BACKSPACE 0x08
+#define NIO_KEY_TAB   0x09 // \t
+
+// Ctrl+letter shortcuts
+#define NIO_KEY_UNDO  0x86 // Ctrl+Z
+#define NIO_KEY_REDO  0x87 // Ctrl+Y
+#define NIO_KEY_FIND  0x88 // Ctrl+F
+#define NIO_KEY_FIND_NEXT 0x89 // Ctrl+G
+#define NIO_KEY_REPLACE 0x8A // Ctrl+R
+#define NIO_KEY_WRAP  0x8B // Ctrl+W
 
 int input_get_key(void);
 
+// Returns 0 if no key is pressed, otherwise same as input_get_key
+int input_poll_key(void);
+
 #endif
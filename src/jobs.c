@@ -0,0 +1,403 @@
+/*
+ * Background jobs
+ *
+ * Long file operations run as queued jobs instead of blocking the
+ * file manager. Each job is a small state machine: jobs_step does
+ * one bounded slice of the job at the front of the queue (a chunk
+ * of a copy, a few entries of a delete or a size scan) and returns,
+ * so the caller can poll the keyboard between slices and keep the
+ * list usable. Jobs run one at a time, in the order they were added.
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "jobs.h"
+#include "checksum.h"
+#include "fs.h"
+#include "ui.h"
+#include "input.h"
+
+#ifndef JOBS_MAX
+#define JOBS_MAX 8
+#endif
+
+// Work done per slice; small enough to keep keys responsive
+#define JOB_COPY_SLICE 16384  // Bytes
+#define JOB_DELETE_SLICE 8    // Entries
+#define JOB_SIZE_SLICE 32     // Entries
+
+// Folders a size scan descends into (one open handle each)
+#define JOB_MAX_DEPTH 16
+
+#define JOB_RUNNING 1
+#define JOB_CANCELLED -5
+
+typedef struct {
+    int kind;
+    int started;
+    char src[1024];
+    char dst[1024];
+    char cur[1024];        // Delete and size: the folder being worked on
+    FILE *in;
+    FILE *out;
+    int verify;            // fs_verify_copies when the copy started
+    int verifying;         // Reading the copy back
+    uint32_t crc;
+    uint32_t copy_crc;
+    unsigned long done;    // Bytes copied or counted, entries deleted
+    unsigned long total;   // Copy: the source's size
+    unsigned long files;
+    DIR *dirs[JOB_MAX_DEPTH];
+    int depth;
+} job_t;
+
+static job_t queue[JOBS_MAX];
+static int queue_count = 0;
+static unsigned char buf[JOB_COPY_SLICE];
+static char last_message[64] = "";
+
+static const char *name_of(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash && slash[1] ? slash + 1 : path;
+}
+
+// Strip the last component, stopping at "/"
+static void path_up(char *path) {
+    char *slash = strrchr(path, '/');
+    if (!slash) return;
+    if (slash == path) slash[1] = '\0';
+    else *slash = '\0';
+}
+
+static void path_join(char *out, size_t size, const char *dir, const char *name) {
+    if (strcmp(dir, "/") == 0) snprintf(out, size, "/%s", name);
+    else snprintf(out, size, "%s/%s", dir, name);
+}
+
+static void format_size(unsigned long size, char *out, size_t out_size) {
+    if (size < 1024) snprintf(out, out_size, "%lu B", size);
+    else if (size < 1024 * 1024) snprintf(out, out_size, "%.1f KB", size / 1024.0);
+    else snprintf(out, out_size, "%.1f MB", size / (1024.0 * 1024.0));
+}
+
+int jobs_add(int kind, const char *src, const char *dst) {
+    if (queue_count >= JOBS_MAX) return -1;
+    for (int i = 0; dst && i < queue_count; i++) {
+        if (queue[i].kind == JOB_COPY && strcmp(queue[i].dst, dst) == 0) return -2;
+    }
+
+    job_t *j = &queue[queue_count++];
+    memset(j, 0, sizeof(*j));
+    j->kind = kind;
+    snprintf(j->src, sizeof(j->src), "%s", src);
+    if (dst) snprintf(j->dst, sizeof(j->dst), "%s", dst);
+    return 0;
+}
+
+int jobs_count(void) {
+    return queue_count;
+}
+
+static int step_copy(job_t *j) {
+    if (!j->started) {
+        j->started = 1;
+        j->verify = fs_verify_copies;
+        struct stat st;
+        if (stat(j->src, &st) == 0) j->total = st.st_size;
+        j->in = fopen(j->src, "rb");
+        if (!j->in) return -1;
+        j->out = fopen(j->dst, "wb");
+        if (!j->out) return -2;
+        return JOB_RUNNING;
+    }
+
+    size_t n = fread(buf, 1, sizeof(buf), j->in);
+    j->done += n;
+    if (j->verifying) {
+        j->copy_crc = checksum_crc32(j->copy_crc, buf, n);
+        if (n == sizeof(buf)) return JOB_RUNNING;
+        return j->copy_crc == j->crc ? 0 : -4;
+    }
+
+    // As fs_copy_file: the source's CRC is taken on the way through
+    if (j->verify) j->crc = checksum_crc32(j->crc, buf, n);
+    if (fwrite(buf, 1, n, j->out) != n) return -3;
+    if (n == sizeof(buf)) return JOB_RUNNING;
+
+    fclose(j->in);
+    j->in = NULL;
+    int res = fclose(j->out);
+    j->out = NULL;
+    if (res != 0) return -3;
+    if (!j->verify) return 0;
+
+    j->in = fopen(j->dst, "rb");
+    if (!j->in) return -4;
+    j->verifying = 1;
+    j->done = 0;
+    return JOB_RUNNING;
+}
+
+/*
+ * Deleting reopens the current folder for every entry and takes the
+ * first one left, so nothing is held open between slices: a folder
+ * is entered when met, and removed once it reads empty.
+ */
+static int step_delete(job_t *j) {
+    for (int n = 0; n < JOB_DELETE_SLICE; n++) {
+        struct stat st;
+        if (!j->started) {
+            j->started = 1;
+            if (stat(j->src, &st) != 0) return -1;
+            if (!S_ISDIR(st.st_mode)) return remove(j->src) == 0 ? 0 : -1;
+            strcpy(j->cur, j->src);
+            continue;
+        }
+
+        char child[1024] = "";
+        DIR *d = opendir(j->cur);
+        if (!d) return -1;
+        struct dirent *ent;
+        while ((ent = readdir(d)) != NULL) {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+            path_join(child, sizeof(child), j->cur, ent->d_name);
+            break;
+        }
+        closedir(d);
+
+        if (child[0]) {
+            if (stat(child, &st) != 0) return -1;
+            if (S_ISDIR(st.st_mode)) {
+                strcpy(j->cur, child);
+                continue;
+            }
+            if (remove(child) != 0) return -1;
+        } else {
+            if (rmdir(j->cur) != 0) return -1;
+            if (strcmp(j->cur, j->src) == 0) return 0;
+            path_up(j->cur);
+        }
+        j->done++;
+    }
+    return JOB_RUNNING;
+}
+
+static int step_size(job_t *j) {
+    for (int n = 0; n < JOB_SIZE_SLICE; n++) {
+        if (!j->started) {
+            j->started = 1;
+            strcpy(j->cur, j->src);
+            j->dirs[0] = opendir(j->cur);
+            if (!j->dirs[0]) return -1;
+            j->depth = 1;
+            continue;
+        }
+
+        struct dirent *ent = readdir(j->dirs[j->depth - 1]);
+        if (!ent) {
+            j->depth--;
+            closedir(j->dirs[j->depth]);
+            j->dirs[j->depth] = NULL;
+            if (j->depth == 0) return 0;
+            path_up(j->cur);
+            continue;
+        }
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+        char child[1024];
+        struct stat st;
+        path_join(child, sizeof(child), j->cur, ent->d_name);
+        if (stat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            // Folders nested deeper than the stack are left out
+            DIR *d = j->depth < JOB_MAX_DEPTH ? opendir(child) : NULL;
+            if (d) {
+                j->dirs[j->depth++] = d;
+                strcpy(j->cur, child);
+            }
+        } else {
+            j->done += st.st_size;
+            j->files++;
+        }
+    }
+    return JOB_RUNNING;
+}
+
+static void release(job_t *j) {
+    if (j->in) fclose(j->in);
+    if (j->out) fclose(j->out);
+    j->in = NULL;
+    j->out = NULL;
+    while (j->depth > 0) {
+        j->depth--;
+        closedir(j->dirs[j->depth]);
+    }
+}
+
+static void remove_job(int index) {
+    memmove(&queue[index], &queue[index + 1], (queue_count - index - 1) * sizeof(job_t));
+    queue_count--;
+}
+
+static void set_outcome(const job_t *j, int result) {
+    const char *name = name_of(j->kind == JOB_COPY ? j->dst : j->src);
+    char size[16];
+    format_size(j->done, size, sizeof(size));
+
+    if (result == JOB_CANCELLED)
+        snprintf(last_message, sizeof(last_message), "Cancelled: %.40s", name);
+    else if (j->kind == JOB_COPY && result == 0)
+        snprintf(last_message, sizeof(last_message), "Copied %.40s", name);
+    else if (j->kind == JOB_COPY && result == -4)
+        snprintf(last_message, sizeof(last_message), "Copy does not match: %.30s", name);
+    else if (j->kind == JOB_COPY)
+        snprintf(last_message, sizeof(last_message), "Copy failed: %.38s", name);
+    else if (j->kind == JOB_DELETE && result == 0)
+        snprintf(last_message, sizeof(last_message), "Deleted %.40s", name);
+    else if (j->kind == JOB_DELETE)
+        snprintf(last_message, sizeof(last_message), "Delete failed: %.36s", name);
+    else if (result == 0)
+        snprintf(last_message, sizeof(last_message), "%.24s: %s in %lu files", name, size, j->files);
+    else
+        snprintf(last_message, sizeof(last_message), "Cannot read %.38s", name);
+}
+
+static void fill_done(const job_t *j, int result, job_done_t *done) {
+    done->kind = j->kind;
+    done->result = result;
+    done->folder[0] = '\0';
+    snprintf(done->path, sizeof(done->path), "%s", j->kind == JOB_COPY ? j->dst : "");
+    if (j->kind == JOB_SIZE || !j->started) return;
+    snprintf(done->folder, sizeof(done->folder), "%s", j->kind == JOB_COPY ? j->dst : j->src);
+    path_up(done->folder);
+}
+
+int jobs_step(job_done_t *done) {
+    if (queue_count == 0) return 0;
+
+    job_t *j = &queue[0];
+    int res;
+    if (j->kind == JOB_COPY) res = step_copy(j);
+    else if (j->kind == JOB_DELETE) res = step_delete(j);
+    else res = step_size(j);
+    if (res == JOB_RUNNING) return 0;
+
+    release(j);
+    set_outcome(j, res);
+    fill_done(j, res, done);
+    remove_job(0);
+    return 1;
+}
+
+void jobs_cancel(int index) {
+    if (index < 0 || index >= queue_count) return;
+    job_t *j = &queue[index];
+    int partial = j->kind == JOB_COPY && j->out != NULL;
+    release(j);
+    if (partial) remove(j->dst);
+    set_outcome(j, JOB_CANCELLED);
+    remove_job(index);
+}
+
+/*
+ * One line for a job: progress first, so it survives cutting.
+ */
+static void describe(const job_t *j, char *out, size_t size) {
+    static const char *verbs[3] = { "Copy", "Delete", "Size" };
+    char progress[16] = "--";
+    if (j->started && j->kind == JOB_COPY)
+        snprintf(progress, sizeof(progress), "%lu%%", j->total ? (unsigned long)((unsigned long long)j->done * 100 / j->total) : 100);
+    else if (j->started && j->kind == JOB_DELETE)
+        snprintf(progress, sizeof(progress), "%lu", j->done);
+    else if (j->started)
+        format_size(j->done, progress, sizeof(progress));
+
+    const char *verb = j->verifying ? "Verify" : verbs[j->kind];
+    snprintf(out, size, "%s %s %s", progress, verb, name_of(j->kind == JOB_COPY ? j->dst : j->src));
+}
+
+void jobs_status(char *out, size_t size) {
+    if (queue_count == 0) {
+        snprintf(out, size, "%s", last_message);
+        return;
+    }
+    char line[64];
+    char more[16] = "";
+    describe(&queue[0], line, sizeof(line));
+    if (queue_count > 1) snprintf(more, sizeof(more), " +%d", queue_count - 1);
+    // The line is 53 characters; the key hint stays visible
+    snprintf(out, size, "%-.40s%s  J:Jobs", line, more);
+}
+
+static void build_list(file_list_t *list) {
+    list->count = 0;
+    for (int i = 0; i < queue_count; i++) {
+        file_entry_t *e = &list->entries[list->count++];
+        memset(e, 0, sizeof(*e)); // Compared whole with what is shown
+        describe(&queue[i], e->name, sizeof(e->name));
+        e->size = queue[i].kind == JOB_COPY ? queue[i].total : queue[i].done;
+    }
+    snprintf(list->path, sizeof(list->path), queue_count ? "Jobs  X:Cancel" : "Jobs  (none)");
+}
+
+int jobs_view(void) {
+    file_list_t list = {0};
+    file_list_t shown = {0};
+    list.entries = malloc(JOBS_MAX * sizeof(file_entry_t));
+    shown.entries = malloc(JOBS_MAX * sizeof(file_entry_t));
+    if (!list.entries || !shown.entries) {
+        free(list.entries);
+        free(shown.entries);
+        return 0;
+    }
+
+    int selection = 0;
+    int scroll_offset = 0;
+    int full_redraw = 1;
+    int changed = 0;
+
+    while (1) {
+        // Progress moves on while the view is open; redraw when it shows
+        build_list(&list);
+        if (selection >= list.count) selection = list.count > 0 ? list.count - 1 : 0;
+        if (full_redraw || list.count != shown.count ||
+            memcmp(list.entries, shown.entries, list.count * sizeof(file_entry_t)) != 0) {
+            ui_draw_list(&list, selection, scroll_offset);
+            memcpy(shown.entries, list.entries, list.count * sizeof(file_entry_t));
+            shown.count = list.count;
+        }
+        full_redraw = 0;
+
+        int c = queue_count ? input_poll_key() : input_get_key();
+        if (c == 0) {
+            job_done_t done;
+            if (jobs_step(&done) && done.folder[0]) changed++;
+            continue;
+        }
+
+        int nav = ui_list_key(&list, c, &selection, &scroll_offset);
+        if (nav) {
+            full_redraw = nav == 2;
+        } else if ((c == 'x' || c == 'X' || c == NIO_KEY_BACKSPACE) && list.count > 0) {
+            char msg[80];
+            snprintf(msg, sizeof(msg), "Cancel %.60s?", list.entries[selection].name);
+            if (ui_get_confirmation(msg)) {
+                if (queue[selection].started && queue[selection].kind != JOB_SIZE) changed++;
+                jobs_cancel(selection);
+            }
+            full_redraw = 1;
+        } else if (c == NIO_KEY_ESC || c == NIO_KEY_LEFT || c == 'q' || c == 'j' || c == 'J') {
+            break;
+        }
+    }
+
+    free(list.entries);
+    free(shown.entries);
+    return changed;
+}
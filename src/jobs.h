@@ -0,0 +1,40 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stddef.h>
+
+#define JOB_COPY 0    // Copy a file (honours fs_verify_copies)
+#define JOB_DELETE 1  // Delete a file or a whole folder
+#define JOB_SIZE 2    // Add up the sizes of the files under a folder
+
+// What a finished job leaves for the file manager to pick up
+typedef struct {
+    int kind;
+    int result;         // 0, or negative as for fs_copy_file (-5: cancelled)
+    char folder[1024];  // Folder whose contents changed, "" if none
+    char path[1024];    // Copy: the file written
+} job_done_t;
+
+// Queue a job; the copy destination is dst (NULL otherwise). Returns
+// 0, -1 when the queue is full, -2 when a queued copy already writes dst.
+int jobs_add(int kind, const char *src, const char *dst);
+int jobs_count(void);
+
+// Do one bounded slice of the job at the front of the queue. Returns
+// 1 when that ended the job, and fills done.
+int jobs_step(job_done_t *done);
+
+// Stop job index (0 is the running one). Partial copies are removed;
+// a partial delete leaves what it has not reached yet.
+void jobs_cancel(int index);
+
+// Text for the status line: the running job and its progress, or
+// the outcome of the last one
+void jobs_status(char *buf, size_t size);
+
+// The queue as a list, stepping the jobs while it is shown. X
+// cancels the selected job. Returns how many jobs that changed a
+// folder finished meanwhile.
+int jobs_view(void);
+
+#endif
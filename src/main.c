@@ -5,8 +5,15 @@
 #include "editor.h"
 #include "viewer.h"
 #include "image_viewer.h"
+#include "text_viewer.h"
 #include "ui.h"
 #include "input.h"
+#include "zip.h"
+#include "tns.h"
+#include "dircmp.h"
+#include "checksum.h"
+#include "dupes.h"
+#include "jobs.h"
 #include "editor.h"
 #include "viewer.h"
 
@@ -38,6 +45,153 @@ static int is_valid_filename(const char *name) {
     
     return 1;
 }
+
+/*
+ * Progress callback for zip_create: redraws the progress box when
+ * the percentage changes. user points to the last percentage drawn.
+ */
+static void compress_progress(void *user, unsigned long done, unsigned long total) {
+    int *last = (int *)user;
+    int percent = total ? (int)((unsigned long long)done * 100 / total) : 100;
+    if (percent == *last) return;
+    *last = percent;
+    ui_draw_progress("Compressing", percent);
+}
+
+/*
+ * Two-pane mode: the active pane lives in main's own list state, the
+ * other one is kept here with its own listing, cursor and scroll.
+ */
+typedef struct {
+    file_list_t list;
+    char path[1024];
+    int selection;
+    int scroll_offset;
+} pane_t;
+
+static void draw_panes(file_list_t *list, int selection, int scroll_offset, pane_t *other, int right_active) {
+    ui_set_list_pane(right_active ? UI_PANE_LEFT : UI_PANE_RIGHT, 0);
+    ui_draw_list(&other->list, other->selection, other->scroll_offset);
+    // The active pane last, so cursor updates draw into its half
+    ui_set_list_pane(right_active ? UI_PANE_RIGHT : UI_PANE_LEFT, 1);
+    ui_draw_list(list, selection, scroll_offset);
+}
+
+/*
+ * Rescan the other pane if it shows path, after a change made there
+ * through the active pane.
+ */
+static void refresh_mirror(pane_t *other, const char *path, int sort_mode) {
+    if (strcmp(other->path, path) != 0) return;
+    fs_scan(other->path, &other->list);
+    fs_sort(&other->list, sort_mode);
+    if (other->selection >= other->list.count) other->selection = other->list.count > 0 ? other->list.count - 1 : 0;
+    if (other->scroll_offset > other->selection) other->scroll_offset = other->selection;
+}
+
+/*
+ * Add entry to a listing, keeping the cursor on the entry it was on
+ * (a rescan of path if out of memory).
+ */
+static void list_insert_keep(file_list_t *list, const char *path, int *selection, int *scroll_offset,
+                             const file_entry_t *entry, int sort_mode) {
+    int old_count = list->count;
+    int idx = fs_list_insert(list, entry, sort_mode);
+    if (idx < 0) {
+        fs_scan(path, list);
+        fs_sort(list, sort_mode);
+        if (*selection >= list->count) *selection = list->count > 0 ? list->count - 1 : 0;
+        if (*scroll_offset > *selection) *scroll_offset = *selection;
+    } else if (list->count > old_count && idx <= *selection && *selection < old_count) {
+        (*selection)++;
+        if (*selection >= *scroll_offset + 25) (*scroll_offset)++;
+    }
+}
+
+/*
+ * Copy or move the selected entry of the active pane into the other
+ * pane's folder. A move patches both listings in place rather than
+ * scanning them again; a copy is queued as a background job, and
+ * its entry is added to the pane showing the destination when it ends.
+ */
+static void transfer_to_pane(file_list_t *list, const char *path, int *selection, int *scroll_offset,
+                             pane_t *other, int move, int sort_mode) {
+    if (list->count == 0 || strcmp(list->entries[*selection].name, "..") == 0) return;
+    file_entry_t entry = list->entries[*selection];
+    
+    if (strcmp(path, other->path) == 0) {
+        ui_draw_modal("Both panes show this folder");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    if (!move && entry.is_dir) {
+        ui_draw_modal("Folders can only be moved");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    
+    char src_path[1024];
+    char dst_path[1024];
+    if (strcmp(path, "/") == 0)
+        snprintf(src_path, sizeof(src_path), "/%s", entry.name);
+    else
+        snprintf(src_path, sizeof(src_path), "%s/%s", path, entry.name);
+    if (strcmp(other->path, "/") == 0)
+        snprintf(dst_path, sizeof(dst_path), "/%s", entry.name);
+    else
+        snprintf(dst_path, sizeof(dst_path), "%s/%s", other->path, entry.name);
+    
+    struct stat st;
+    if (stat(dst_path, &st) == 0) {
+        if (S_ISDIR(st.st_mode) || entry.is_dir) {
+            ui_draw_modal("Name in use");
+            wait_key_pressed();
+            wait_no_key_pressed();
+            return;
+        }
+        char msg[270];
+        snprintf(msg, sizeof(msg), "Replace %s?", entry.name);
+        if (!ui_get_confirmation(msg)) return;
+        if (move) remove(dst_path);
+    }
+    
+    if (!move) {
+        int queued = jobs_add(JOB_COPY, src_path, dst_path);
+        if (queued != 0) {
+            ui_draw_modal(queued == -2 ? "Already being copied there" : "Too many jobs queued");
+            wait_key_pressed();
+            wait_no_key_pressed();
+        }
+        return;
+    }
+    if (rename(src_path, dst_path) != 0) {
+        ui_draw_modal("Move failed");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    
+    list_insert_keep(&other->list, other->path, &other->selection, &other->scroll_offset, &entry, sort_mode);
+    fs_list_remove(list, *selection);
+    if (*selection >= list->count && *selection > 0) (*selection)--;
+    if (*scroll_offset > *selection) *scroll_offset = *selection;
+}
+
+/*
+ * Redraw the status line when the jobs' text changed, or with force
+ * after the lists were drawn over it. shown holds the text on screen.
+ */
+static void draw_job_status(char *shown, size_t size, int force) {
+    char status[64];
+    jobs_status(status, sizeof(status));
+    if (!force && strcmp(status, shown) == 0) return;
+    snprintf(shown, size, "%s", status);
+    if (force && !status[0]) return; // Drawing the lists cleared it
+    ui_draw_status(status);
+}
+
 int main(int argc, char **argv) {
     // 1. Initialize Console
     nio_console csl;
@@ -67,6 +221,11 @@ int main(int argc, char **argv) {
     // Sort State
     int sort_mode = SORT_NAME;
     
+    // Two-pane State
+    int dual_pane = 0;
+    int right_active = 0;
+    pane_t other = {0};
+    
     // Scan initial
     uart_printf("Scanning %s...\n", current_path);
     if (fs_scan(current_path, &file_list) != 0) {
@@ -78,33 +237,65 @@ int main(int argc, char **argv) {
     fs_sort(&file_list, sort_mode);
     uart_printf("Scan Done. Count: %d\n", file_list.count);
     
+    // Cursor moves repaint only the rows they touch
+    int full_redraw = 1;
+    
+    // Background jobs: the status line as last drawn
+    char status_shown[64] = "";
+    
     // 3. Event Loop
     while (1) {
         uart_printf("Loop Start. Path: %s\n", current_path);
 
         // Render
-        ui_draw_list(&file_list, selection, scroll_offset);
-        
-        // Input (Robust)
-        int c = input_get_key();
+        if (full_redraw) {
+            if (dual_pane)
+                draw_panes(&file_list, selection, scroll_offset, &other, right_active);
+            else
+                ui_draw_list(&file_list, selection, scroll_offset);
+            draw_job_status(status_shown, sizeof(status_shown), 1);
+        }
+        full_redraw = 1;
         
-        // Logic
-        if (c == NIO_KEY_DOWN) {
-            if (selection < file_list.count - 1) {
-                selection++;
-                // Scroll down if needed
-                if (selection >= scroll_offset + 25) { // MAX_VISIBLE_ROWS
-                    scroll_offset++;
-                }
-            }
-        } else if (c == NIO_KEY_UP) {
-            if (selection > 0) {
-                selection--;
-                // Scroll up if needed
-                if (selection < scroll_offset) {
-                    scroll_offset--;
+        // Input (Robust). Queued jobs run a slice at a time while no
+        // key is down; the listings showing a folder a job changed are
+        // updated when it ends.
+        int c = 0;
+        int rescanned = 0;
+        while (!rescanned && jobs_count() > 0 && (c = input_poll_key()) == 0) {
+            job_done_t done;
+            struct stat st;
+            if (!jobs_step(&done) || !done.folder[0]) {
+                draw_job_status(status_shown, sizeof(status_shown), 0);
+            } else if (done.kind == JOB_COPY && (done.result == 0 || done.result == -4) && stat(done.path, &st) == 0) {
+                // A finished copy is one new entry: patch the listings in place
+                file_entry_t entry = {0};
+                snprintf(entry.name, sizeof(entry.name), "%s", strrchr(done.path, '/') + 1);
+                entry.size = (unsigned int)st.st_size;
+                entry.mtime = (unsigned int)st.st_mtime;
+                if (strcmp(done.folder, current_path) == 0)
+                    list_insert_keep(&file_list, current_path, &selection, &scroll_offset, &entry, sort_mode);
+                if (dual_pane && strcmp(done.folder, other.path) == 0)
+                    list_insert_keep(&other.list, other.path, &other.selection, &other.scroll_offset, &entry, sort_mode);
+                rescanned = 1;
+            } else {
+                if (strcmp(done.folder, current_path) == 0) {
+                    fs_scan(current_path, &file_list);
+                    fs_sort(&file_list, sort_mode);
+                    if (selection >= file_list.count) selection = file_list.count > 0 ? file_list.count - 1 : 0;
+                    if (scroll_offset > selection) scroll_offset = selection;
                 }
+                if (dual_pane) refresh_mirror(&other, done.folder, sort_mode);
+                rescanned = 1;
             }
+        }
+        if (rescanned) continue;
+        if (c == 0) c = input_get_key();
+        
+        // Logic
+        int nav = ui_list_key(&file_list, c, &selection, &scroll_offset);
+        if (nav) {
+            full_redraw = nav == 2;
         } else if (c == NIO_KEY_ENTER || c == NIO_KEY_RIGHT) {
             open_file:
             // Open selected item
@@ -125,11 +316,14 @@ int main(int argc, char **argv) {
                     snprintf(new_path, sizeof(new_path), "%s/%s", current_path, sel->name);
                 
                 fs_scan(new_path, &file_list);
+                fs_sort(&file_list, sort_mode);
                 strcpy(current_path, new_path);
                 selection = 0;
                 scroll_offset = 0;
             } else {
                 // Open/Launch File
+                // Viewers and archive browsers use the whole screen
+                ui_set_list_pane(UI_PANE_FULL, 1);
                 char full_path[1024];
                 if (strcmp(current_path, "/") == 0)
                     snprintf(full_path, sizeof(full_path), "/%s", sel->name);
@@ -137,48 +331,46 @@ int main(int argc, char **argv) {
                     snprintf(full_path, sizeof(full_path), "%s/%s", current_path, sel->name);
                 
                 const char *ext = strrchr(sel->name, '.');
-                int is_image = 0;
+                int is_image = image_viewer_is_image(sel->name);
                 int is_binary = 0;
                 
                 if (ext) {
-                    // Check for standard extensions
-                    if (strcasecmp(ext, ".png") == 0 || strcasecmp(ext, ".jpg") == 0 || 
-                        strcasecmp(ext, ".jpeg") == 0 || strcasecmp(ext, ".bmp") == 0 ||
-                        strcasecmp(ext, ".tga") == 0) {
-                        is_image = 1;
-                    } 
-                    // Check for .tns appended extensions (e.g. image.png.tns)
-                    else if (strlen(sel->name) > 4) {
-                        // Check if it ends in .tns
-                        if (strcasecmp(ext, ".tns") == 0) {
-                             // Check the part before .tns
-                             // We don't have strcasestr but we can check specific suffixes
-                             int len = strlen(sel->name);
-                             if (len > 8 && strcasecmp(sel->name + len - 8, ".png.tns") == 0) is_image = 1;
-                             else if (len > 8 && strcasecmp(sel->name + len - 8, ".jpg.tns") == 0) is_image = 1;
-                             else if (len > 8 && strcasecmp(sel->name + len - 8, ".bmp.tns") == 0) is_image = 1;
-                             else if (len > 8 && strcasecmp(sel->name + len - 8, ".tga.tns") == 0) is_image = 1;
-                             else if (len > 9 && strcasecmp(sel->name + len - 9, ".jpeg.tns") == 0) is_image = 1;
-                        }
-                    }
-                    
                     if (!is_image) {
                          if (strcasecmp(ext, ".tns") == 0 ||
                                strcasecmp(ext, ".tno") == 0 ||
                                strcasecmp(ext, ".tco") == 0 ||
-                               strcasecmp(ext, ".tcc") == 0 ||
-                               strcasecmp(ext, ".zip") == 0) {
+                               strcasecmp(ext, ".tcc") == 0) {
                             is_binary = 1;
                          }
                     }
                 }
                 
-                if (is_image) {
-                     image_viewer_open(full_path);
+                if (zip_is_archive(sel->name)) {
+                    // Browse the archive; extracted members land in this folder
+                    if (zip_browse(full_path)) {
+                        fs_scan(current_path, &file_list);
+                        fs_sort(&file_list, sort_mode);
+                        if (dual_pane) refresh_mirror(&other, current_path, sort_mode);
+                    }
+                } else if (is_image) {
+                     // Left/Right in the viewer walk the folder's images
+                     selection = image_viewer_browse(&file_list, selection);
+                     if (selection < scroll_offset || selection >= scroll_offset + 25) {
+                         scroll_offset = selection;
+                     }
                 } else if (ext && (strcasecmp(ext, ".txt") == 0 || strcasecmp(ext, ".c") == 0 || 
                            strcasecmp(ext, ".h") == 0 || strcasecmp(ext, ".lua") == 0 || 
-                           strcasecmp(ext, ".md") == 0)) {
-                    editor_open(full_path);
+                           strcasecmp(ext, ".md") == 0 || strcasecmp(ext, ".py") == 0)) {
+                    // Files too big for the editor buffer open read-only
+                    if (!editor_fits(full_path))
+                        text_viewer_open(full_path);
+                    else
+                        editor_open(full_path);
+                } else if (ext && (strcasecmp(ext, ".log") == 0 || strcasecmp(ext, ".csv") == 0)) {
+                    text_viewer_open(full_path);
+                } else if (is_binary && tns_identify(full_path, NULL) == TNS_DOCUMENT) {
+                    // Documents are not programs: list their parts instead
+                    tns_inspect(full_path);
                 } else if (is_binary) {
                     nl_exec(full_path, 0, NULL);
                 } else {
@@ -199,14 +391,42 @@ int main(int argc, char **argv) {
                  }
                  
                  fs_scan(current_path, &file_list);
+                 fs_sort(&file_list, sort_mode);
                  selection = 0;
                  scroll_offset = 0;
             } else {
                 // At root, do nothing (User requested: "why esc exits?")
                 // break; 
             }
+        } else if (c == NIO_KEY_TAB && dual_pane) {
+            // Switch panes: the other pane's state becomes main's
+            pane_t active = { file_list, "", selection, scroll_offset };
+            strcpy(active.path, current_path);
+            file_list = other.list;
+            strcpy(current_path, other.path);
+            selection = other.selection;
+            scroll_offset = other.scroll_offset;
+            other = active;
+            right_active = !right_active;
+        } else if ((c == 'c' || c == 'm') && dual_pane) {
+            transfer_to_pane(&file_list, current_path, &selection, &scroll_offset, &other, c == 'm', sort_mode);
+        } else if (c == 'j' || c == 'J') {
+            show_jobs:
+            ui_set_list_pane(UI_PANE_FULL, 1);
+            if (jobs_view()) {
+                fs_scan(current_path, &file_list);
+                fs_sort(&file_list, sort_mode);
+                if (selection >= file_list.count) selection = file_list.count > 0 ? file_list.count - 1 : 0;
+                if (scroll_offset > selection) scroll_offset = selection;
+                if (dual_pane) refresh_mirror(&other, other.path, sort_mode);
+            }
         } else if (c == 'q') {
-            if (ui_get_confirmation("Do you want to exit?")) {
+            exit_confirm:
+            if (jobs_count() > 0) {
+                char msg[64];
+                snprintf(msg, sizeof(msg), "Cancel %d job%s and exit?", jobs_count(), jobs_count() == 1 ? "" : "s");
+                if (ui_get_confirmation(msg)) goto exit_app;
+            } else if (ui_get_confirmation("Do you want to exit?")) {
                 goto exit_app;
             }
         } else if (c == NIO_KEY_MENU) { // Menu options
@@ -221,9 +441,17 @@ int main(int argc, char **argv) {
                  "Sort: Name/Size",
                  "New Directory",
                  "New File",
+                 "Thumbnails",
+                 "Compress",
+                 "Two Panes",
+                 "Compare Panes",
+                 "Checksum",
+                 "Duplicates",
+                 "Folder Size",
+                 "Jobs",
                  "Exit"
              };
-             int opt_count = 11;
+             int opt_count = 19;
              int opt_sel = 0;
              
              // Menu Loop
@@ -298,7 +526,15 @@ int main(int argc, char **argv) {
                                          break;
                                      }
                                  }
-                                 res = fs_copy_file(clipboard_path, dst_path);
+                                 // Copies run in the background; the listing is
+                                 // rescanned when the job ends
+                                 res = jobs_add(JOB_COPY, clipboard_path, dst_path);
+                                 if (res != 0) {
+                                     ui_draw_modal(res == -2 ? "Already being copied there" : "Too many jobs queued");
+                                     wait_key_pressed();
+                                     wait_no_key_pressed();
+                                 }
+                                 break;
                              } else if (clipboard_mode == 2) { // Cut (Move)
                                  // Same-path move is a no-op
                                  if (strcmp(clipboard_path, dst_path) == 0) {
@@ -346,15 +582,16 @@ int main(int argc, char **argv) {
                                 else
                                     snprintf(full_path, sizeof(full_path), "%s/%s", current_path, file_list.entries[selection].name);
                                 
-                                // Try remove (files) or rmdir (folders)
-                                int res = remove(full_path); 
-                                // If it's a dir and remove/rmdir failed (likely not empty), try recursive
-                                if (res != 0 && file_list.entries[selection].is_dir) {
-                                    res = fs_delete_recursive(full_path);
-                                }
+                                // Folders are emptied in the background; the
+                                // listing is rescanned when the job ends
+                                int res;
+                                if (file_list.entries[selection].is_dir)
+                                    res = jobs_add(JOB_DELETE, full_path, NULL);
+                                else
+                                    res = remove(full_path);
                                 
                                 if (res != 0) {
-                                     ui_draw_modal("Directory not empty");
+                                     ui_draw_modal(file_list.entries[selection].is_dir ? "Too many jobs queued" : "Delete failed");
                                      wait_key_pressed();
                                      wait_no_key_pressed();
                                 }
@@ -417,6 +654,7 @@ int main(int argc, char **argv) {
                      } else if (opt_sel == 7) { // Sort
                          sort_mode = (sort_mode == SORT_NAME) ? SORT_SIZE : SORT_NAME;
                          fs_sort(&file_list, sort_mode);
+                         if (dual_pane) fs_sort(&other.list, sort_mode);
                          break;
                      } else if (opt_sel == 8) { // New Folder
                          char name[64] = "";
@@ -506,20 +744,155 @@ int main(int argc, char **argv) {
                              fs_sort(&file_list, sort_mode);
                          }
                          break;
-                     } else if (opt_sel == 10) { // Exit
-                         goto exit_app;
+                     } else if (opt_sel == 10) { // Thumbnails
+                         int picked = ui_thumbnail_grid(&file_list, selection);
+                         if (picked >= 0) {
+                             selection = picked;
+                             if (selection < scroll_offset || selection >= scroll_offset + 25) {
+                                 scroll_offset = selection;
+                             }
+                             goto open_file;
+                         }
+                         break;
+                     } else if (opt_sel == 11) { // Compress
+                         if (file_list.count == 0 || strcmp(file_list.entries[selection].name, "..") == 0) {
+                             ui_draw_modal("Nothing to compress");
+                             wait_key_pressed();
+                             wait_no_key_pressed();
+                             break;
+                         }
+                         
+                         char src_path[1024];
+                         if (strcmp(current_path, "/") == 0)
+                             snprintf(src_path, sizeof(src_path), "/%s", file_list.entries[selection].name);
+                         else
+                             snprintf(src_path, sizeof(src_path), "%s/%s", current_path, file_list.entries[selection].name);
+                         
+                         // "name.zip" next to it, or a copy name if taken
+                         char zip_name[1024];
+                         char zip_path[1024];
+                         snprintf(zip_name, sizeof(zip_name), "%s.zip", src_path);
+                         strcpy(zip_path, zip_name);
+                         struct stat st;
+                         if (stat(zip_name, &st) == 0 &&
+                             fs_generate_copy_name(zip_name, zip_path, sizeof(zip_path)) != 0) {
+                             ui_draw_modal("Too many copies");
+                             wait_key_pressed();
+                             wait_no_key_pressed();
+                             break;
+                         }
+                         
+                         int last_percent = 0;
+                         ui_draw_progress("Compressing", 0);
+                         int res = zip_create(src_path, zip_path, compress_progress, &last_percent);
+                         if (res == ZIP_ERR_READ) ui_draw_modal("Read failed");
+                         else if (res == ZIP_ERR_CREATE) ui_draw_modal("Cannot create archive");
+                         else if (res == ZIP_ERR_LIMIT) ui_draw_modal("Too many files");
+                         else if (res == ZIP_ERR_MEM) ui_draw_modal("Out of memory");
+                         else if (res != 0) ui_draw_modal("Write failed");
+                         else ui_draw_modal("Compressed");
+                         wait_key_pressed();
+                         wait_no_key_pressed();
+                         
+                         fs_scan(current_path, &file_list);
+                         fs_sort(&file_list, sort_mode);
+                         break;
+                     } else if (opt_sel == 12) { // Two Panes
+                         dual_pane = !dual_pane;
+                         if (dual_pane) {
+                             // The new pane starts in the same folder
+                             strcpy(other.path, current_path);
+                             fs_scan(other.path, &other.list);
+                             fs_sort(&other.list, sort_mode);
+                             other.selection = 0;
+                             other.scroll_offset = 0;
+                             right_active = 0;
+                         } else {
+                             fs_free(&other.list);
+                             ui_set_list_pane(UI_PANE_FULL, 1);
+                         }
+                         break;
+                     } else if (opt_sel == 13) { // Compare Panes
+                         if (!dual_pane) {
+                             ui_draw_modal("Open two panes first");
+                             wait_key_pressed();
+                             wait_no_key_pressed();
+                             break;
+                         }
+                         
+                         // Syncing goes from the active pane to the other
+                         ui_set_list_pane(UI_PANE_FULL, 1);
+                         const char *left = right_active ? other.path : current_path;
+                         const char *right = right_active ? current_path : other.path;
+                         if (dircmp_view(left, right, right_active)) {
+                             fs_scan(current_path, &file_list);
+                             fs_sort(&file_list, sort_mode);
+                             if (selection >= file_list.count) selection = file_list.count > 0 ? file_list.count - 1 : 0;
+                             if (scroll_offset > selection) scroll_offset = selection;
+                             refresh_mirror(&other, other.path, sort_mode); // Unconditional
+                         }
+                         break;
+                     } else if (opt_sel == 14) { // Checksum
+                         if (file_list.count == 0 || file_list.entries[selection].is_dir) {
+                             ui_draw_modal("Select a file");
+                             wait_key_pressed();
+                             wait_no_key_pressed();
+                             break;
+                         }
+                         char full_path[1024];
+                         if (strcmp(current_path, "/") == 0)
+                             snprintf(full_path, sizeof(full_path), "/%s", file_list.entries[selection].name);
+                         else
+                             snprintf(full_path, sizeof(full_path), "%s/%s", current_path, file_list.entries[selection].name);
+                         checksum_view(full_path);
+                         break;
+                     } else if (opt_sel == 15) { // Duplicates
+                         ui_set_list_pane(UI_PANE_FULL, 1);
+                         if (dupes_view(current_path)) {
+                             fs_scan(current_path, &file_list);
+                             fs_sort(&file_list, sort_mode);
+                             if (selection >= file_list.count) selection = file_list.count > 0 ? file_list.count - 1 : 0;
+                             if (scroll_offset > selection) scroll_offset = selection;
+                             // The other pane may show a subfolder of this one
+                             if (dual_pane) refresh_mirror(&other, other.path, sort_mode);
+                         }
+                         break;
+                     } else if (opt_sel == 16) { // Folder Size
+                         // The selected folder, or this one
+                         char full_path[1024];
+                         file_entry_t *sel = file_list.count > 0 ? &file_list.entries[selection] : NULL;
+                         if (!sel || !sel->is_dir || strcmp(sel->name, "..") == 0)
+                             snprintf(full_path, sizeof(full_path), "%s", current_path);
+                         else if (strcmp(current_path, "/") == 0)
+                             snprintf(full_path, sizeof(full_path), "/%s", sel->name);
+                         else
+                             snprintf(full_path, sizeof(full_path), "%s/%s", current_path, sel->name);
+                         if (jobs_add(JOB_SIZE, full_path, NULL) != 0) {
+                             ui_draw_modal("Too many jobs queued");
+                             wait_key_pressed();
+                             wait_no_key_pressed();
+                         }
+                         break;
+                     } else if (opt_sel == 17) { // Jobs
+                         goto show_jobs;
+                     } else if (opt_sel == 18) { // Exit
+                         if (jobs_count() == 0) goto exit_app;
+                         goto exit_confirm;
                      }
                      break; 
                  }
                  
                  // Menu overlay uses double buffer, no need to redraw background
              }
-             // Force redraw of main list upon exit
-             ui_draw_list(&file_list, selection, scroll_offset);
+             // Menu actions may have changed a folder both panes show;
+             // the main list is redrawn at the top of the loop
+             if (dual_pane) refresh_mirror(&other, current_path, sort_mode);
         }
     }
     
     exit_app:
+    // Partial copies are removed
+    while (jobs_count() > 0) jobs_cancel(0);
     nio_free(&csl);
     return 0;
 }
@@ -0,0 +1,202 @@
+/*
+ * Decoded-image cache
+ *
+ * Keeps the screen-sized renders of recently viewed images (RGB565,
+ * or 4bpp on grayscale models), keyed by a hash of the path plus the
+ * file size, mtime and render size, so an edited file is never
+ * served stale. Entries live for the whole
+ * session and the least recently used one is evicted when
+ * RENDER_CACHE_BUDGET is reached.
+ *
+ * With RENDER_CACHE_SPILL_SLOTS > 0, evicted renders are written to
+ * RENDER_CACHE_DIR (one file per hash slot, so the directory stays
+ * bounded) and read back on a memory miss.
+ */
+
+#include <libndls.h>
+#include <stdio.h>
+#include <string.h>
+#include "render_cache.h"
+
+#define RENDER_BYTES (320 * 240 * (int)sizeof(uint16_t))
+
+#ifndef RENDER_CACHE_BUDGET
+#define RENDER_CACHE_BUDGET (4 * RENDER_BYTES) // ~600 KB
+#endif
+#define RENDER_CACHE_SLOTS (RENDER_CACHE_BUDGET / RENDER_BYTES)
+
+// Disk spill, off by default: every spilled render is 150 KB of flash
+#ifndef RENDER_CACHE_SPILL_SLOTS
+#define RENDER_CACHE_SPILL_SLOTS 0
+#endif
+#ifndef RENDER_CACHE_DIR
+#define RENDER_CACHE_DIR "/documents/ndless/nspire-fm.cache"
+#endif
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t bytes; // Render size, tells the formats apart
+} render_key_t;
+
+typedef struct {
+    render_key_t key;
+    unsigned int stamp; // Last use, 0 = empty
+    int capacity;       // Bytes allocated for px
+    void *px;
+} render_entry_t;
+
+static render_entry_t entries[RENDER_CACHE_SLOTS > 0 ? RENDER_CACHE_SLOTS : 1];
+static unsigned int use_clock = 0;
+
+/*
+ * Key of a render: FNV-1a hash of the path, size, mtime and render
+ * size. Returns -1 if the file cannot be stat'ed.
+ */
+static int make_key(const char *path, int bytes, render_key_t *key) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+
+    uint32_t h = 2166136261u;
+    for (const char *p = path; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    key->hash = h;
+    key->size = (uint32_t)st.st_size;
+    key->mtime = (uint32_t)st.st_mtime;
+    key->bytes = (uint32_t)bytes;
+    return 0;
+}
+
+#if RENDER_CACHE_SPILL_SLOTS > 0
+static void spill_path(const render_key_t *key, char *buf, size_t size) {
+    snprintf(buf, size, "%s/%02u.tns", RENDER_CACHE_DIR,
+             (unsigned)(key->hash % RENDER_CACHE_SPILL_SLOTS));
+}
+
+/*
+ * Write an evicted render to its spill file.
+ */
+static void spill_write(const render_entry_t *e) {
+    char path[256];
+    spill_path(&e->key, path, sizeof(path));
+    mkdir(RENDER_CACHE_DIR, 0755);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+    int ok = fwrite(&e->key, sizeof(e->key), 1, f) == 1 &&
+             fwrite(e->px, e->key.bytes, 1, f) == 1;
+    fclose(f);
+    if (!ok) remove(path); // Never leave a truncated render behind
+}
+
+/*
+ * Read a render back from its spill file if the key matches.
+ */
+static int spill_read(const render_key_t *key, void *out) {
+    char path[256];
+    spill_path(key, path, sizeof(path));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    render_key_t stored;
+    int ok = fread(&stored, sizeof(stored), 1, f) == 1 &&
+             memcmp(&stored, key, sizeof(stored)) == 0 &&
+             fread(out, key->bytes, 1, f) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+#endif
+
+/*
+ * Slot for a new entry: an empty one, else the least recently used
+ * (spilled to disk first when enabled).
+ */
+static render_entry_t *take_slot(void) {
+    render_entry_t *victim = &entries[0];
+    for (int i = 0; i < RENDER_CACHE_SLOTS; i++) {
+        if (entries[i].stamp == 0) return &entries[i];
+        if (entries[i].stamp < victim->stamp) victim = &entries[i];
+    }
+#if RENDER_CACHE_SPILL_SLOTS > 0
+    spill_write(victim);
+#endif
+    victim->stamp = 0;
+    return victim;
+}
+
+/*
+ * Store a render under key, allocating the slot's pixels on first use.
+ */
+static void store(const render_key_t *key, const void *vram) {
+    if (RENDER_CACHE_SLOTS <= 0 || key->bytes > RENDER_BYTES) return;
+
+    // Sized to the render, so gray renders take a quarter of the memory
+    render_entry_t *e = take_slot();
+    if (e->capacity < (int)key->bytes) {
+        free(e->px);
+        e->px = malloc(key->bytes);
+        e->capacity = e->px ? (int)key->bytes : 0;
+        if (!e->px) return;
+    }
+    memcpy(e->px, vram, key->bytes);
+    e->key = *key;
+    e->stamp = ++use_clock;
+}
+
+int render_cache_get(const char *path, void *out, int bytes) {
+    render_key_t key;
+    if (make_key(path, bytes, &key) != 0) return -1;
+
+    for (int i = 0; i < RENDER_CACHE_SLOTS; i++) {
+        render_entry_t *e = &entries[i];
+        if (e->stamp && memcmp(&e->key, &key, sizeof(key)) == 0) {
+            memcpy(out, e->px, bytes);
+            e->stamp = ++use_clock;
+            return 0;
+        }
+    }
+
+#if RENDER_CACHE_SPILL_SLOTS > 0
+    if (spill_read(&key, out) == 0) {
+        store(&key, out);
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+void render_cache_put(const char *path, const void *vram, int bytes) {
+    render_key_t key;
+    if (make_key(path, bytes, &key) != 0) return;
+
+    // Replace an existing entry for the same file
+    for (int i = 0; i < RENDER_CACHE_SLOTS; i++) {
+        render_entry_t *e = &entries[i];
+        if (e->stamp && memcmp(&e->key, &key, sizeof(key)) == 0) {
+            memcpy(e->px, vram, bytes);
+            e->stamp = ++use_clock;
+            return;
+        }
+    }
+    store(&key, vram);
+}
+
+void render_cache_clear(void) {
+    for (int i = 0; i < RENDER_CACHE_SLOTS; i++) {
+        free(entries[i].px);
+        entries[i].px = NULL;
+        entries[i].capacity = 0;
+        entries[i].stamp = 0;
+    }
+#if RENDER_CACHE_SPILL_SLOTS > 0
+    for (int i = 0; i < RENDER_CACHE_SPILL_SLOTS; i++) {
+        char path[256];
+        render_key_t key = { (uint32_t)i, 0, 0, 0 };
+        spill_path(&key, path, sizeof(path));
+        remove(path);
+    }
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <stdint.h>
+
+// Copy the cached screen render of path (bytes long: RGB565 or
+// 4bpp gray) into out. Returns 0 on a hit, -1 if the file is not
+// cached, has changed, or was cached in another format.
+int render_cache_get(const char *path, void *out, int bytes);
+
+// Remember the render of path (evicting the least recently used)
+void render_cache_put(const char *path, const void *vram, int bytes);
+
+// Drop every cached render (e.g. when the rendering settings change)
+void render_cache_clear(void);
+
+#endif
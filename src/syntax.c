@@ -0,0 +1,206 @@
+/*
+ * Syntax highlighting lexer
+ *
+ * A small line-at-a-time lexer for C, Lua and Python. It does not
+ * build tokens, it only assigns a colour class to every character.
+ * The only context that crosses line boundaries (block comments,
+ * long strings, triple-quoted strings) is returned as an end state,
+ * so the editor can cache it per line and re-lex only what changed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "syntax.h"
+
+#define MAX_KEYWORD_LEN 16
+
+// Keyword tables, sorted for bsearch
+static const char *c_keywords[] = {
+    "NULL", "auto", "bool", "break", "case", "char", "const", "continue",
+    "default", "do", "double", "else", "enum", "extern", "false", "float",
+    "for", "goto", "if", "inline", "int", "long", "register", "return",
+    "short", "signed", "size_t", "sizeof", "static", "struct", "switch",
+    "true", "typedef", "uint16_t", "uint32_t", "uint8_t", "union",
+    "unsigned", "void", "volatile", "while"
+};
+
+static const char *lua_keywords[] = {
+    "and", "break", "do", "else", "elseif", "end", "false", "for",
+    "function", "goto", "if", "in", "local", "nil", "not", "or",
+    "repeat", "return", "then", "true", "until", "while"
+};
+
+static const char *python_keywords[] = {
+    "False", "None", "True", "and", "as", "assert", "break", "class",
+    "continue", "def", "del", "elif", "else", "except", "finally", "for",
+    "from", "global", "if", "import", "in", "is", "lambda", "nonlocal",
+    "not", "or", "pass", "raise", "return", "self", "try", "while",
+    "with", "yield"
+};
+
+#define COUNT_OF(a) ((int)(sizeof(a) / sizeof(a[0])))
+
+static int compare_keyword(const void *key, const void *entry) {
+    return strcmp((const char *)key, *(const char * const *)entry);
+}
+
+static int is_keyword(int lang, const char *word, int len) {
+    if (len >= MAX_KEYWORD_LEN) return 0;
+
+    char buf[MAX_KEYWORD_LEN];
+    memcpy(buf, word, len);
+    buf[len] = '\0';
+
+    const char **table;
+    int count;
+    if (lang == SYN_LANG_C) {
+        table = c_keywords;
+        count = COUNT_OF(c_keywords);
+    } else if (lang == SYN_LANG_LUA) {
+        table = lua_keywords;
+        count = COUNT_OF(lua_keywords);
+    } else {
+        table = python_keywords;
+        count = COUNT_OF(python_keywords);
+    }
+    return bsearch(buf, table, count, sizeof(table[0]), compare_keyword) != NULL;
+}
+
+int syntax_detect(const char *filename) {
+    const char *ext = strrchr(filename, '.');
+    if (!ext) return SYN_LANG_NONE;
+    if (strcasecmp(ext, ".c") == 0 || strcasecmp(ext, ".h") == 0) return SYN_LANG_C;
+    if (strcasecmp(ext, ".lua") == 0) return SYN_LANG_LUA;
+    if (strcasecmp(ext, ".py") == 0) return SYN_LANG_PYTHON;
+    return SYN_LANG_NONE;
+}
+
+/*
+ * Mark characters from i up to and including the terminator `end`
+ * with cls_value. Returns the index after the terminator, or -1 if
+ * the line ended first (everything to the end is marked).
+ */
+static int lex_until(const char *line, int i, int len, const char *end,
+                     unsigned char *cls, unsigned char cls_value) {
+    const char *hit = strstr(line + i, end);
+    int stop = hit ? (int)(hit - line) + (int)strlen(end) : len;
+    memset(cls + i, cls_value, stop - i);
+    return hit ? stop : -1;
+}
+
+/*
+ * Quoted string starting at i (line[i] is the quote). Backslash
+ * escapes are skipped. Returns the index after the closing quote.
+ */
+static int lex_string(const char *line, int i, int len, unsigned char *cls) {
+    char quote = line[i];
+    int j = i + 1;
+    while (j < len && line[j] != quote) {
+        if (line[j] == '\\' && j + 1 < len) j++;
+        j++;
+    }
+    if (j < len) j++;
+    memset(cls + i, SYN_STRING, j - i);
+    return j;
+}
+
+int syntax_lex_line(int lang, const char *line, int state, unsigned char *cls) {
+    int len = strlen(line);
+    memset(cls, SYN_DEFAULT, len);
+    if (lang == SYN_LANG_NONE) return SYN_STATE_NORMAL;
+
+    int i = 0;
+
+    // Finish a construct carried over from the previous line
+    if (state != SYN_STATE_NORMAL) {
+        const char *end;
+        unsigned char value = SYN_STRING;
+        if (state == SYN_STATE_BLOCK_COMMENT) {
+            end = (lang == SYN_LANG_C) ? "*/" : "]]";
+            value = SYN_COMMENT;
+        } else if (state == SYN_STATE_LONG_STRING) {
+            end = "]]";
+        } else if (state == SYN_STATE_TRIPLE_SQ) {
+            end = "'''";
+        } else {
+            end = "\"\"\"";
+        }
+        i = lex_until(line, 0, len, end, cls, value);
+        if (i < 0) return state;
+        state = SYN_STATE_NORMAL;
+    }
+
+    // C preprocessor lines
+    if (lang == SYN_LANG_C) {
+        int j = i;
+        while (line[j] == ' ' || line[j] == '\t') j++;
+        if (line[j] == '#') {
+            memset(cls + j, SYN_PREPROC, len - j);
+            return SYN_STATE_NORMAL;
+        }
+    }
+
+    while (i < len) {
+        char ch = line[i];
+
+        // Comments and multi-line constructs
+        if (lang == SYN_LANG_C && ch == '/' && line[i + 1] == '/') {
+            memset(cls + i, SYN_COMMENT, len - i);
+            return SYN_STATE_NORMAL;
+        }
+        if (lang == SYN_LANG_C && ch == '/' && line[i + 1] == '*') {
+            memset(cls + i, SYN_COMMENT, 2);
+            i = lex_until(line, i + 2, len, "*/", cls, SYN_COMMENT);
+            if (i < 0) return SYN_STATE_BLOCK_COMMENT;
+            continue;
+        }
+        if (lang == SYN_LANG_LUA && ch == '-' && line[i + 1] == '-') {
+            if (line[i + 2] == '[' && line[i + 3] == '[') {
+                memset(cls + i, SYN_COMMENT, 4);
+                i = lex_until(line, i + 4, len, "]]", cls, SYN_COMMENT);
+                if (i < 0) return SYN_STATE_BLOCK_COMMENT;
+                continue;
+            }
+            memset(cls + i, SYN_COMMENT, len - i);
+            return SYN_STATE_NORMAL;
+        }
+        if (lang == SYN_LANG_LUA && ch == '[' && line[i + 1] == '[') {
+            memset(cls + i, SYN_STRING, 2);
+            i = lex_until(line, i + 2, len, "]]", cls, SYN_STRING);
+            if (i < 0) return SYN_STATE_LONG_STRING;
+            continue;
+        }
+        if (lang == SYN_LANG_PYTHON && ch == '#') {
+            memset(cls + i, SYN_COMMENT, len - i);
+            return SYN_STATE_NORMAL;
+        }
+        if (lang == SYN_LANG_PYTHON && (ch == '\'' || ch == '"') &&
+            line[i + 1] == ch && line[i + 2] == ch) {
+            const char *end = (ch == '\'') ? "'''" : "\"\"\"";
+            memset(cls + i, SYN_STRING, 3);
+            i = lex_until(line, i + 3, len, end, cls, SYN_STRING);
+            if (i < 0) return (ch == '\'') ? SYN_STATE_TRIPLE_SQ : SYN_STATE_TRIPLE_DQ;
+            continue;
+        }
+
+        // Single-line tokens
+        if (ch == '"' || ch == '\'') {
+            i = lex_string(line, i, len, cls);
+        } else if (isdigit((unsigned char)ch)) {
+            int j = i;
+            while (j < len && (isalnum((unsigned char)line[j]) || line[j] == '.')) j++;
+            memset(cls + i, SYN_NUMBER, j - i);
+            i = j;
+        } else if (isalpha((unsigned char)ch) || ch == '_') {
+            int j = i;
+            while (j < len && (isalnum((unsigned char)line[j]) || line[j] == '_')) j++;
+            if (is_keyword(lang, line + i, j - i)) memset(cls + i, SYN_KEYWORD, j - i);
+            i = j;
+        } else {
+            i++;
+        }
+    }
+
+    return SYN_STATE_NORMAL;
+}
@@ -0,0 +1,32 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+// Languages
+#define SYN_LANG_NONE   0
+#define SYN_LANG_C      1
+#define SYN_LANG_LUA    2
+#define SYN_LANG_PYTHON 3
+
+// Character classes produced by the lexer
+#define SYN_DEFAULT  0
+#define SYN_KEYWORD  1
+#define SYN_STRING   2
+#define SYN_COMMENT  3
+#define SYN_NUMBER   4
+#define SYN_PREPROC  5
+
+// Lexer state carried from the end of one line to the next
+#define SYN_STATE_NORMAL        0
+#define SYN_STATE_BLOCK_COMMENT 1 // C /* */, Lua --[[ ]]
+#define SYN_STATE_LONG_STRING   2 // Lua [[ ]]
+#define SYN_STATE_TRIPLE_SQ     3 // Python '''
+#define SYN_STATE_TRIPLE_DQ     4 // Python """
+
+// Pick a language from the file extension
+int syntax_detect(const char *filename);
+
+// Classify each character of line into cls (strlen(line) entries),
+// starting in state. Returns the state at the end of the line.
+int syntax_lex_line(int lang, const char *line, int state, unsigned char *cls);
+
+#endif
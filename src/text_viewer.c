@@ -0,0 +1,384 @@
+/*
+ * Text Viewer
+ *
+ * Read-only viewer for text files of any size (logs, CSV exports...).
+ * The file is never loaded whole: rows are read through a small
+ * sliding window, and a sparse line index (one checkpoint every
+ * `stride` lines) is built between key polls. When the index is
+ * full, the stride doubles and every other checkpoint is dropped,
+ * so memory stays constant regardless of file size.
+ *
+ * Controls: Up/Down=Row, Left/Right=Page, G=Goto line or %,
+ *           W=Wrap, Esc=Exit
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "text_viewer.h"
+#include "ui.h"
+#include "input.h"
+
+#define TV_COLS 53
+#define TV_ROWS 26
+
+#define WINDOW_SIZE 4096
+#define INDEX_CAPACITY 1024
+#define INDEX_CHUNK 4096
+#define INDEX_STRIDE 16
+
+typedef struct {
+    FILE *f;
+    long size;
+
+    // Sliding read window
+    unsigned char window[WINDOW_SIZE];
+    long window_start;
+    int window_len;
+
+    // Sparse line index: checkpoints[k] = offset of line k * stride
+    long checkpoints[INDEX_CAPACITY];
+    int checkpoint_count;
+    long stride;
+    long indexed_pos;   // Bytes scanned so far
+    long indexed_lines; // Newlines seen before indexed_pos
+    int index_done;
+    long line_count;    // Lines in the file, once index_done
+
+    // View
+    long top;           // Offset of the first visible row
+    int wrap;
+} text_viewer_t;
+
+/*
+ * Return the byte at offset, reloading the window if needed.
+ * backward hints that the caller is scanning towards the start
+ * of the file, so the window is placed to end at offset.
+ */
+static int tv_byte(text_viewer_t *tv, long offset, int backward) {
+    if (offset < tv->window_start || offset >= tv->window_start + tv->window_len) {
+        long start = offset;
+        if (backward) {
+            start = offset - WINDOW_SIZE + 1;
+            if (start < 0) start = 0;
+        }
+        fseek(tv->f, start, SEEK_SET);
+        tv->window_start = start;
+        tv->window_len = fread(tv->window, 1, WINDOW_SIZE, tv->f);
+        if (offset >= tv->window_start + tv->window_len) return -1;
+    }
+    return tv->window[offset - tv->window_start];
+}
+
+/* Offset of the line following the one containing offset. */
+static long tv_next_line(text_viewer_t *tv, long offset) {
+    while (offset < tv->size) {
+        if (tv_byte(tv, offset++, 0) == '\n') break;
+    }
+    return offset;
+}
+
+/* Offset of the start of the line containing offset. */
+static long tv_line_start(text_viewer_t *tv, long offset) {
+    while (offset > 0 && tv_byte(tv, offset - 1, 1) != '\n') offset--;
+    return offset;
+}
+
+/*
+ * Offset of the row following the one starting at offset.
+ * Without wrap a row is a whole line; with wrap it is at most
+ * TV_COLS characters.
+ */
+static long tv_next_row(text_viewer_t *tv, long offset) {
+    if (!tv->wrap) return tv_next_line(tv, offset);
+
+    for (int col = 0; col < TV_COLS && offset < tv->size; col++) {
+        if (tv_byte(tv, offset++, 0) == '\n') return offset;
+    }
+    // A newline right at the wrap column belongs to this row
+    if (offset < tv->size && tv_byte(tv, offset, 0) == '\n') offset++;
+    return offset;
+}
+
+/* Offset of the row preceding the one starting at offset. */
+static long tv_prev_row(text_viewer_t *tv, long offset) {
+    if (offset <= 0) return 0;
+
+    long row = tv_line_start(tv, offset - 1);
+    if (!tv->wrap) return row;
+
+    // Walk the wrapped rows of the previous line up to offset
+    long next;
+    while ((next = tv_next_row(tv, row)) < offset) row = next;
+    return row;
+}
+
+/*
+ * Record the start of line tv->indexed_lines, compacting the
+ * index (doubling the stride) when it is full.
+ */
+static void tv_add_checkpoint(text_viewer_t *tv, long offset) {
+    if (tv->checkpoint_count == INDEX_CAPACITY) {
+        for (int i = 0; i < INDEX_CAPACITY / 2; i++) {
+            tv->checkpoints[i] = tv->checkpoints[i * 2];
+        }
+        tv->checkpoint_count = INDEX_CAPACITY / 2;
+        tv->stride *= 2;
+        if (tv->indexed_lines % tv->stride != 0) return;
+    }
+    tv->checkpoints[tv->checkpoint_count++] = offset;
+}
+
+/*
+ * The index reached the end of the file. A final newline ends the
+ * last line rather than starting another one.
+ */
+static void tv_index_finish(text_viewer_t *tv) {
+    tv->index_done = 1;
+    tv->line_count = tv->indexed_lines;
+    if (tv->size == 0 || tv_byte(tv, tv->size - 1, 1) != '\n') tv->line_count++;
+}
+
+/*
+ * Scan the next chunk of the file for the line index.
+ * Cheap enough to run between key polls.
+ */
+static void tv_index_step(text_viewer_t *tv) {
+    unsigned char buf[INDEX_CHUNK];
+
+    fseek(tv->f, tv->indexed_pos, SEEK_SET);
+    int n = fread(buf, 1, sizeof(buf), tv->f);
+    if (n <= 0) {
+        tv_index_finish(tv);
+        return;
+    }
+
+    unsigned char *p = buf;
+    unsigned char *end = buf + n;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+        tv->indexed_lines++;
+        if (tv->indexed_lines % tv->stride == 0) {
+            tv_add_checkpoint(tv, tv->indexed_pos + (p - buf));
+        }
+    }
+
+    tv->indexed_pos += n;
+    if (tv->indexed_pos >= tv->size) tv_index_finish(tv);
+}
+
+/* Count newlines in [from, to). */
+static long tv_count_lines(text_viewer_t *tv, long from, long to) {
+    long lines = 0;
+    while (from < to) {
+        tv_byte(tv, from, 0);
+        long end = tv->window_start + tv->window_len;
+        if (end > to) end = to;
+        if (end <= from) break;
+
+        const unsigned char *p = tv->window + (from - tv->window_start);
+        const unsigned char *stop = tv->window + (end - tv->window_start);
+        while ((p = memchr(p, '\n', stop - p)) != NULL) {
+            p++;
+            lines++;
+        }
+        from = end;
+    }
+    return lines;
+}
+
+/*
+ * Zero-based line number of offset, or -1 if the index has not
+ * reached it yet.
+ */
+static long tv_line_number(text_viewer_t *tv, long offset) {
+    if (offset > tv->indexed_pos) return -1;
+
+    // Last checkpoint at or before offset
+    int lo = 0, hi = tv->checkpoint_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (tv->checkpoints[mid] <= offset) lo = mid; else hi = mid - 1;
+    }
+    return lo * tv->stride + tv_count_lines(tv, tv->checkpoints[lo], offset);
+}
+
+/*
+ * Offset of the given zero-based line. Extends the index first if
+ * the line lies beyond it, and clamps to the last line.
+ */
+static long tv_line_offset(text_viewer_t *tv, long line) {
+    while (!tv->index_done && tv->indexed_lines < line) tv_index_step(tv);
+    long last = tv->index_done ? tv->line_count - 1 : tv->indexed_lines;
+    if (line > last) line = last;
+
+    long k = line / tv->stride;
+    long offset = tv->checkpoints[k];
+    for (long l = k * tv->stride; l < line; l++) {
+        offset = tv_next_line(tv, offset);
+    }
+    return offset;
+}
+
+static void tv_draw_header(text_viewer_t *tv, const char *title) {
+    nio_vram_fill(0, 0, 320, 10, NIO_COLOR_BLUE);
+    nio_vram_grid_puts(0, 0, 0, 0, title, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
+
+    char info[48];
+    long line = tv_line_number(tv, tv->top);
+    int pct = tv->size > 0 ? (int)((tv->top * 100.0) / tv->size) : 100;
+    if (tv->index_done) {
+        snprintf(info, sizeof(info), "L%ld/%ld %3d%%", line + 1, tv->line_count, pct);
+    } else {
+        int idx_pct = (int)((tv->indexed_pos * 100.0) / tv->size);
+        if (line >= 0)
+            snprintf(info, sizeof(info), "L%ld %3d%% idx%d%%", line + 1, pct, idx_pct);
+        else
+            snprintf(info, sizeof(info), "L? %3d%% idx%d%%", pct, idx_pct);
+    }
+
+    int x = 320 - (int)strlen(info) * 6;
+    nio_vram_fill(x - 6, 0, 320 - x + 6, 10, NIO_COLOR_BLUE);
+    nio_vram_grid_puts(x, 0, 0, 0, info, NIO_COLOR_BLUE, NIO_COLOR_YELLOW);
+}
+
+static void tv_draw(text_viewer_t *tv, const char *title) {
+    nio_console *console = nio_get_default();
+    nio_clear(console);
+
+    tv_draw_header(tv, title);
+
+    nio_vram_fill(0, 10, 320, 220, NIO_COLOR_WHITE);
+
+    long offset = tv->top;
+    char row[TV_COLS + 1];
+    for (int i = 0; i < TV_ROWS && offset < tv->size; i++) {
+        long next = tv_next_row(tv, offset);
+
+        int len = 0;
+        for (long p = offset; p < next && len < TV_COLS; p++) {
+            int ch = tv_byte(tv, p, 0);
+            if (ch == '\n' || ch == '\r') continue;
+            if (ch == '\t') ch = ' ';
+            row[len++] = (ch >= 32 && ch <= 126) ? ch : '.';
+        }
+        row[len] = '\0';
+
+        nio_vram_grid_puts(0, 12 + i * 8, 0, 0, row, NIO_COLOR_WHITE, NIO_COLOR_BLACK);
+        offset = next;
+    }
+
+    // Footer
+    nio_vram_fill(0, 230, 320, 10, NIO_COLOR_GRAY);
+    nio_vram_grid_puts(0, 231, 0, 0, tv->wrap ? "L/R:Page G:Goto W:Unwrap Esc:Exit"
+                                              : "L/R:Page G:Goto W:Wrap Esc:Exit",
+                       NIO_COLOR_GRAY, NIO_COLOR_WHITE);
+
+    nio_vram_draw();
+}
+
+/*
+ * Prompt for a line number or a percentage ("50%") and move there.
+ */
+static void tv_goto(text_viewer_t *tv) {
+    char input_buf[16] = "";
+    if (!ui_get_string("Go to line (or N%):", input_buf, sizeof(input_buf))) return;
+
+    long value = strtol(input_buf, NULL, 10);
+    if (value < 0) value = 0;
+
+    if (strchr(input_buf, '%')) {
+        if (value > 100) value = 100;
+        long target = (long)((tv->size * (double)value) / 100);
+        if (target >= tv->size) target = tv->size > 0 ? tv->size - 1 : 0;
+        tv->top = tv_line_start(tv, target);
+    } else {
+        if (value > 0) value--; // Lines are shown 1-based
+        ui_draw_modal("Indexing...");
+        tv->top = tv_line_offset(tv, value);
+    }
+}
+
+/*
+ * Opens a file in the text viewer.
+ *
+ * Index building runs while waiting for keys; the header is
+ * refreshed as it progresses.
+ */
+void text_viewer_open(const char *filepath) {
+    text_viewer_t *tv = malloc(sizeof(text_viewer_t));
+    if (!tv) {
+        ui_draw_modal("Error: Out of memory.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return;
+    }
+    memset(tv, 0, sizeof(*tv));
+
+    tv->f = fopen(filepath, "rb");
+    if (!tv->f) {
+        free(tv);
+        return;
+    }
+
+    fseek(tv->f, 0, SEEK_END);
+    tv->size = ftell(tv->f);
+    fseek(tv->f, 0, SEEK_SET);
+
+    tv->stride = INDEX_STRIDE;
+    tv->checkpoints[0] = 0;
+    tv->checkpoint_count = 1;
+    if (tv->size == 0) tv_index_finish(tv);
+    tv->wrap = 1;
+
+    // Extract filename for title
+    const char *title = strrchr(filepath, '/');
+    if (title) title++; else title = filepath;
+
+    while (1) {
+        tv_draw(tv, title);
+
+        int c;
+        int steps = 0;
+        while ((c = input_poll_key()) == 0) {
+            if (tv->index_done) {
+                c = input_get_key();
+                break;
+            }
+            tv_index_step(tv);
+            if (++steps % 16 == 0 || tv->index_done) {
+                tv_draw_header(tv, title);
+                nio_vram_draw();
+            }
+        }
+
+        if (c == NIO_KEY_ESC) {
+            break;
+        } else if (c == NIO_KEY_UP) {
+            tv->top = tv_prev_row(tv, tv->top);
+        } else if (c == NIO_KEY_DOWN) {
+            long next = tv_next_row(tv, tv->top);
+            if (next < tv->size) tv->top = next;
+        } else if (c == NIO_KEY_LEFT) {
+            for (int i = 0; i < TV_ROWS && tv->top > 0; i++) {
+                tv->top = tv_prev_row(tv, tv->top);
+            }
+        } else if (c == NIO_KEY_RIGHT) {
+            for (int i = 0; i < TV_ROWS; i++) {
+                long next = tv_next_row(tv, tv->top);
+                if (next >= tv->size) break;
+                tv->top = next;
+            }
+        } else if (c == 'w' || c == 'W') {
+            tv->wrap = !tv->wrap;
+            tv->top = tv_line_start(tv, tv->top);
+        } else if (c == 'g' || c == 'G') {
+            tv_goto(tv);
+        }
+    }
+
+    fclose(tv->f);
+    free(tv);
+}
@@ -0,0 +1,8 @@
+#ifndef TEXT_VIEWER_H
+#define TEXT_VIEWER_H
+
+// Read-only viewer for large text files
+// Returns when user presses Esc
+void text_viewer_open(const char *filepath);
+
+#endif
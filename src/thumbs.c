@@ -0,0 +1,138 @@
+/*
+ * Thumbnail cache
+ *
+ * Thumbnails are kept in a single cache file: a magic header
+ * followed by fixed-size records, each a key (hash of the full
+ * path, file size, mtime) and THUMB_W x THUMB_H RGB565 pixels.
+ * The keys are read into memory when the cache is first used, so
+ * a lookup is a scan of a small table and one fread. A changed file
+ * gets a new key and is decoded again; when the file is full it is
+ * started over.
+ */
+
+#include <libndls.h>
+#include <stdio.h>
+#include <string.h>
+#include "thumbs.h"
+#include "image_viewer.h"
+
+#ifndef THUMB_CACHE_PATH
+#define THUMB_CACHE_PATH "/documents/ndless/nspire-fm.thumbs.tns"
+#endif
+#ifndef THUMB_CACHE_MAX
+#define THUMB_CACHE_MAX 256 // ~1.4 MB of records
+#endif
+
+#define THUMB_MAGIC 0x3154464E // "NFT1"
+#define THUMB_PIXELS_SIZE (THUMB_W * THUMB_H * (int)sizeof(uint16_t))
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t mtime;
+} thumb_key_t;
+
+#define THUMB_RECORD_SIZE ((long)sizeof(thumb_key_t) + THUMB_PIXELS_SIZE)
+
+static FILE *cache_file = NULL;
+static thumb_key_t cache_keys[THUMB_CACHE_MAX];
+static int cache_count = 0;
+
+/*
+ * FNV-1a hash of the path.
+ */
+static uint32_t hash_path(const char *path) {
+    uint32_t h = 2166136261u;
+    while (*path) {
+        h ^= (unsigned char)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Start an empty cache file. Returns 0 on success.
+ */
+static int cache_reset(void) {
+    if (cache_file) fclose(cache_file);
+    cache_count = 0;
+    cache_file = fopen(THUMB_CACHE_PATH, "w+b");
+    if (!cache_file) return -1;
+
+    uint32_t magic = THUMB_MAGIC;
+    if (fwrite(&magic, sizeof(magic), 1, cache_file) != 1) {
+        fclose(cache_file);
+        cache_file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Open the cache file and load its keys, creating it if missing
+ * or not in the current format.
+ */
+static int cache_open(void) {
+    if (cache_file) return 0;
+
+    cache_file = fopen(THUMB_CACHE_PATH, "r+b");
+    if (!cache_file) return cache_reset();
+
+    uint32_t magic = 0;
+    if (fread(&magic, sizeof(magic), 1, cache_file) != 1 || magic != THUMB_MAGIC) {
+        return cache_reset();
+    }
+
+    cache_count = 0;
+    while (cache_count < THUMB_CACHE_MAX) {
+        long off = sizeof(uint32_t) + cache_count * THUMB_RECORD_SIZE;
+        if (fseek(cache_file, off, SEEK_SET) != 0 ||
+            fread(&cache_keys[cache_count], sizeof(thumb_key_t), 1, cache_file) != 1) {
+            break;
+        }
+        cache_count++;
+    }
+    return 0;
+}
+
+void thumbs_close(void) {
+    if (cache_file) {
+        fclose(cache_file);
+        cache_file = NULL;
+    }
+    cache_count = 0;
+}
+
+int thumbs_get(const char *path, unsigned int size, unsigned int mtime, uint16_t *out) {
+    thumb_key_t key = { hash_path(path), size, mtime };
+    int have_cache = (cache_open() == 0);
+
+    // Cached?
+    if (have_cache) {
+        for (int i = cache_count - 1; i >= 0; i--) {
+            if (memcmp(&cache_keys[i], &key, sizeof(key)) != 0) continue;
+            long off = sizeof(uint32_t) + i * THUMB_RECORD_SIZE + sizeof(thumb_key_t);
+            if (fseek(cache_file, off, SEEK_SET) == 0 &&
+                fread(out, THUMB_PIXELS_SIZE, 1, cache_file) == 1) {
+                return 0;
+            }
+            break;
+        }
+    }
+
+    if (image_decode_thumbnail(path, out, THUMB_W, THUMB_H) != 0) return -1;
+
+    // Append the new record (a failed write only costs a re-decode later)
+    if (have_cache && cache_count >= THUMB_CACHE_MAX) {
+        have_cache = (cache_reset() == 0);
+    }
+    if (have_cache) {
+        long off = sizeof(uint32_t) + cache_count * THUMB_RECORD_SIZE;
+        if (fseek(cache_file, off, SEEK_SET) == 0 &&
+            fwrite(&key, sizeof(key), 1, cache_file) == 1 &&
+            fwrite(out, THUMB_PIXELS_SIZE, 1, cache_file) == 1) {
+            cache_keys[cache_count++] = key;
+        }
+    }
+    return 0;
+}
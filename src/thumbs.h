@@ -0,0 +1,16 @@
+#ifndef THUMBS_H
+#define THUMBS_H
+
+#include <stdint.h>
+
+#define THUMB_W 60
+#define THUMB_H 45
+
+// Fill out (THUMB_W x THUMB_H RGB565) from the cache or by decoding.
+// Returns 0 on success, -1 if the image could not be decoded.
+int thumbs_get(const char *path, unsigned int size, unsigned int mtime, uint16_t *out);
+
+// Close the cache file (call when leaving the grid view)
+void thumbs_close(void);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * TNS inspector
+ *
+ * A .tns file is either an Ndless program (raw "PRG" or "Zehn"
+ * binaries, launched with nl_exec) or a TI-Nspire document: a zip
+ * whose first local header signature is replaced by "*TIMLP" and a
+ * four-digit format version. The offsets in such a document's
+ * central directory do not account for the longer signature, so
+ * parts are found by walking the local headers from the front
+ * instead: each header is read and the part's data skipped with a
+ * seek, so listing a document never touches the data itself.
+ *
+ * Viewing a part decodes just that part (through zip's extractor)
+ * to a scratch file that the text, image or hex viewer then opens.
+ * XML parts written by the TI software are usually encrypted and
+ * can only be listed.
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tns.h"
+#include "zip.h"
+#include "ui.h"
+#include "input.h"
+#include "viewer.h"
+#include "text_viewer.h"
+#include "image_viewer.h"
+
+#ifndef TNS_PART_PATH
+#define TNS_PART_PATH "/documents/ndless/nspire-fm.part"
+#endif
+
+#define SIG_LOCAL 0x04034b50
+#define LOCAL_SIZE 30
+#define DOC_MAGIC "*TIMLP"
+#define DOC_MAGIC_LEN 6
+#define DOC_HEADER_LEN 10 // Magic and version, in place of the 4-byte signature
+
+static uint16_t get16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+int tns_identify(const char *path, char *version) {
+    unsigned char h[DOC_HEADER_LEN];
+    FILE *f = fopen(path, "rb");
+    if (!f) return TNS_UNKNOWN;
+    size_t n = fread(h, 1, sizeof(h), f);
+    fclose(f);
+
+    if (version) version[0] = '\0';
+    if (n >= 4 && (memcmp(h, "PRG", 4) == 0 || memcmp(h, "Zehn", 4) == 0)) return TNS_PROGRAM;
+    if (n == DOC_HEADER_LEN && memcmp(h, DOC_MAGIC, DOC_MAGIC_LEN) == 0) {
+        if (version) {
+            memcpy(version, h + DOC_MAGIC_LEN, 4);
+            version[4] = '\0';
+        }
+        return TNS_DOCUMENT;
+    }
+    // Some third-party tools write documents as plain zips
+    if (n >= 4 && get32(h) == SIG_LOCAL) return TNS_DOCUMENT;
+    return TNS_UNKNOWN;
+}
+
+static int add_part(tns_document_t *doc, int *capacity, uint32_t *names_capacity, uint32_t *names_used,
+                    const char *name, int name_len, const zip_member_t *rec) {
+    zip_archive_t *z = &doc->parts;
+    if (z->count >= *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        zip_member_t *members = realloc(z->members, new_capacity * sizeof(zip_member_t));
+        if (!members) return -1;
+        z->members = members;
+        *capacity = new_capacity;
+    }
+    if (*names_used + name_len + 1 > *names_capacity) {
+        uint32_t new_capacity = *names_capacity ? *names_capacity * 2 : 512;
+        while (new_capacity < *names_used + name_len + 1) new_capacity *= 2;
+        char *names = realloc(z->names, new_capacity);
+        if (!names) return -1;
+        z->names = names;
+        *names_capacity = new_capacity;
+    }
+    memcpy(z->names + *names_used, name, name_len);
+    z->names[*names_used + name_len] = '\0';
+    z->members[z->count] = *rec;
+    z->members[z->count].name = *names_used;
+    z->count++;
+    *names_used += name_len + 1;
+    return 0;
+}
+
+int tns_open(const char *path, tns_document_t *doc) {
+    memset(doc, 0, sizeof(*doc));
+    if (tns_identify(path, doc->version) != TNS_DOCUMENT) return -1;
+    snprintf(doc->parts.path, sizeof(doc->parts.path), "%s", path);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    // With the TI header the first record's fields follow the version
+    // digits, so its header effectively starts 6 bytes in
+    long pos = doc->version[0] ? DOC_HEADER_LEN - 4 : 0;
+    int capacity = 0;
+    uint32_t names_capacity = 0, names_used = 0;
+    unsigned char h[LOCAL_SIZE];
+    char name[256];
+    int first = 1;
+
+    while (fseek(f, pos, SEEK_SET) == 0 && fread(h, 1, LOCAL_SIZE, f) == LOCAL_SIZE) {
+        // The first "signature" is the version digits
+        if (!(first && doc->version[0]) && get32(h) != SIG_LOCAL) break;
+        first = 0;
+
+        zip_member_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.flags = get16(h + 6);
+        rec.method = get16(h + 8);
+        rec.time = get16(h + 10);
+        rec.date = get16(h + 12);
+        rec.crc = get32(h + 14);
+        rec.csize = get32(h + 18);
+        rec.usize = get32(h + 22);
+        int name_len = get16(h + 26);
+        int extra_len = get16(h + 28);
+
+        // Sizes deferred to a data descriptor leave no way to find
+        // the next header without decoding: list what came before
+        if ((rec.flags & 8) && rec.csize == 0) break;
+
+        int keep = name_len < (int)sizeof(name) ? name_len : (int)sizeof(name) - 1;
+        if (fread(name, 1, keep, f) != (size_t)keep) break;
+        rec.offset = pos + LOCAL_SIZE + name_len + extra_len;
+
+        // Folder records carry no data worth listing
+        if (keep > 0 && name[keep - 1] != '/' &&
+            add_part(doc, &capacity, &names_capacity, &names_used, name, keep, &rec) != 0) {
+            fclose(f);
+            tns_close(doc);
+            return -1;
+        }
+        pos = rec.offset + rec.csize;
+    }
+    fclose(f);
+    return 0;
+}
+
+void tns_close(tns_document_t *doc) {
+    zip_close(&doc->parts);
+}
+
+const char *tns_part_kind(const char *name) {
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    const char *ext = strrchr(base, '.');
+
+    if (image_viewer_is_image(base)) return "Image";
+    if (ext && strcasecmp(ext, ".lua") == 0) return "Lua";
+    if (strncasecmp(base, "Problem", 7) == 0) return "Problem";
+    if (strcasecmp(base, "Document.xml") == 0) return "Document";
+    return "Part";
+}
+
+static void show_message(const char *msg) {
+    ui_draw_modal(msg);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
+static int is_text_part(const char *name) {
+    static const char *const exts[] = { ".xml", ".lua", ".txt", ".css", ".js", NULL };
+    const char *ext = strrchr(name, '.');
+    if (!ext) return 0;
+    for (int i = 0; exts[i]; i++) {
+        if (strcasecmp(ext, exts[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Decode one part to the scratch file and open it in the viewer
+ * that suits it.
+ */
+static void view_part(const tns_document_t *doc, int part) {
+    const zip_member_t *m = &doc->parts.members[part];
+    const char *name = doc->parts.names + m->name;
+
+    // Keep the extension: the image viewer picks its decoder by name
+    char scratch[300];
+    const char *ext = strrchr(name, '.');
+    if (ext && strchr(ext, '/')) ext = NULL;
+    snprintf(scratch, sizeof(scratch), "%s%s", TNS_PART_PATH, ext ? ext : "");
+
+    ui_draw_modal("Decoding...");
+    int res = zip_extract_data(doc->parts.path, m, m->offset, scratch);
+    if (res == ZIP_ERR_METHOD) {
+        show_message("Part is encrypted");
+        return;
+    } else if (res == ZIP_ERR_DATA) {
+        show_message("Part is corrupt");
+        return;
+    } else if (res != 0) {
+        show_message(res == ZIP_ERR_READ ? "Read failed" : "Write failed");
+        return;
+    }
+
+    if (image_viewer_is_image(scratch)) image_viewer_open(scratch);
+    else if (is_text_part(name)) text_viewer_open(scratch);
+    else viewer_open(scratch);
+    remove(scratch);
+}
+
+/*
+ * One list entry per part, ".." first, in document order. Returns
+ * 0 or -1 when out of memory.
+ */
+static int build_list(const tns_document_t *doc, const char *path, file_list_t *list) {
+    list->entries = malloc((doc->parts.count + 1) * sizeof(file_entry_t));
+    if (!list->entries) return -1;
+    list->count = 0;
+
+    file_entry_t *up = &list->entries[list->count++];
+    memset(up, 0, sizeof(*up));
+    strcpy(up->name, "..");
+    up->is_dir = 1;
+
+    int problems = 0, images = 0, scripts = 0;
+    for (int i = 0; i < doc->parts.count; i++) {
+        const zip_member_t *m = &doc->parts.members[i];
+        const char *name = doc->parts.names + m->name;
+        const char *kind = tns_part_kind(name);
+        if (strcmp(kind, "Problem") == 0) problems++;
+        else if (strcmp(kind, "Image") == 0) images++;
+        else if (strcmp(kind, "Lua") == 0) scripts++;
+
+        file_entry_t *e = &list->entries[list->count++];
+        memset(e, 0, sizeof(*e));
+        snprintf(e->name, sizeof(e->name), "%s", name);
+        e->size = m->usize;
+    }
+
+    // The header line summarises the document
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(list->path, sizeof(list->path), "%s [v%s] %dP %dI %dL", base,
+             doc->version[0] ? doc->version : "zip", problems, images, scripts);
+    return 0;
+}
+
+void tns_inspect(const char *path) {
+    tns_document_t doc;
+    if (tns_open(path, &doc) != 0) {
+        show_message("Not a readable TNS document");
+        return;
+    }
+
+    file_list_t list = {0};
+    if (build_list(&doc, path, &list) != 0) {
+        tns_close(&doc);
+        show_message("Out of memory");
+        return;
+    }
+
+    int selection = 0;
+    int scroll_offset = 0;
+    int full_redraw = 1;
+
+    while (1) {
+        if (full_redraw) ui_draw_list(&list, selection, scroll_offset);
+        full_redraw = 1;
+
+        int c = input_get_key();
+        int nav = ui_list_key(&list, c, &selection, &scroll_offset);
+
+        if (nav) {
+            full_redraw = nav == 2;
+        } else if (c == NIO_KEY_ENTER || c == NIO_KEY_RIGHT) {
+            if (selection == 0) break; // ".."
+            view_part(&doc, selection - 1);
+        } else if (c == NIO_KEY_ESC || c == NIO_KEY_LEFT || c == 'q') {
+            break;
+        } else {
+            full_redraw = 0;
+        }
+    }
+
+    fs_free(&list);
+    tns_close(&doc);
+}
@@ -0,0 +1,32 @@
+#ifndef TNS_H
+#define TNS_H
+
+#include "zip.h"
+
+#define TNS_UNKNOWN 0
+#define TNS_PROGRAM 1  // Ndless binary, for nl_exec
+#define TNS_DOCUMENT 2 // TI-Nspire document container
+
+// Parts of a document, indexed from their local headers only.
+// members[i].offset is the start of the part's data, not its header.
+typedef struct {
+    zip_archive_t parts;
+    char version[5]; // Format version from the header, "" for a plain zip
+} tns_document_t;
+
+// Look at the first bytes of path. version (5 bytes, may be NULL)
+// receives a document's format version.
+int tns_identify(const char *path, char *version);
+
+// Index the parts of a document. Returns 0, or -1 if path is not a
+// readable document.
+int tns_open(const char *path, tns_document_t *doc);
+void tns_close(tns_document_t *doc);
+
+// "Problem", "Image", "Lua", "Document" or "Part"
+const char *tns_part_kind(const char *name);
+
+// List the parts of a document; Enter views one
+void tns_inspect(const char *path);
+
+#endif
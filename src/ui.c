@@ -2,14 +2,36 @@
 #include <libndls.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "fs.h"
+#include "ui.h"
 #include "input.h"
+#include "image_viewer.h"
+#include "thumbs.h"
 
 // Constants
 #define MAX_VISIBLE_ROWS 25
 #define HEADER_height 1
 #define FOOTER_height 1
 
+// Thumbnail grid: 5x4 cells of 64x60 pixels
+#define GRID_COLS 5
+#define GRID_ROWS 4
+#define GRID_CELL_W 64
+#define GRID_CELL_H 60
+#define GRID_PAGE (GRID_COLS * GRID_ROWS)
+
+// RGB565 colors used by the grid (drawn outside NIO)
+#define GRID_BG 0x2104
+#define GRID_SELECT 0x07FF
+#define GRID_MISSING 0x4208
+
+// List area: the whole screen, or one half in two-pane mode. The
+// inactive pane shows its header and cursor in gray.
+static int list_x = 0;
+static int list_w = 320;
+static int list_active = 1;
+
 /*
  * Format a file size into a human-readable string.
  * E.g., 1024 -> "1.0 KB", 1048576 -> "1.0 MB"
@@ -24,6 +46,65 @@ static void format_file_size(unsigned int size, char *buf, size_t buf_size) {
     }
 }
 
+/*
+ * Draw one entry of the list at its screen row.
+ */
+static void draw_list_row(file_list_t *list, int entry_idx, int row, int is_selected) {
+    file_entry_t *entry = &list->entries[entry_idx];
+    
+    // Pixel y position of the row (Row 1 * 8 + 2px offset = 10px start)
+    int row_y_px = row * 8 + 2;
+    
+    // Fill row background (selection or plain)
+    int bg = is_selected ? (list_active ? NIO_COLOR_CYAN : NIO_COLOR_GRAY) : NIO_COLOR_BLACK;
+    nio_vram_fill(list_x, row_y_px, list_w, 8, bg);
+    
+    // Construct line with name and size - consistent format for all entries
+    // Format: "[icon] [name padded to 25 chars] [size/type padded to 8 chars]"
+    // A half-width pane has room for 15 chars of the name, cut to fit
+    char line[64];
+    char size_str[16] = "";
+    int name_w = list_w < 320 ? 15 : 25;
+    int name_max = list_w < 320 ? 15 : 255;
+    
+    if (entry->is_dir) {
+        if (strcmp(entry->name, "..") == 0) {
+            snprintf(line, sizeof(line), "/ %-*.*s %8s", name_w, name_max, "..", "<UP>");
+        } else {
+            snprintf(line, sizeof(line), "/ %-*.*s %8s", name_w, name_max, entry->name, "<DIR>");
+        }
+    } else {
+        format_file_size(entry->size, size_str, sizeof(size_str));
+        snprintf(line, sizeof(line), "  %-*.*s %8s", name_w, name_max, entry->name, size_str);
+    }
+    
+    // Use grid put with offset_y=2 to clear the header
+    nio_vram_grid_puts(list_x, 2, 0, row, line, 
+                       bg, is_selected ? NIO_COLOR_BLACK : NIO_COLOR_WHITE);
+}
+
+/*
+ * Draw the footer (instructions + page indicator).
+ */
+static void draw_list_footer(file_list_t *list, int scroll_offset) {
+    int footer_y = 29; // Approx bottom
+    
+    // Calculate page info
+    int total_pages = (list->count + MAX_VISIBLE_ROWS - 1) / MAX_VISIBLE_ROWS;
+    int current_page = (scroll_offset / MAX_VISIBLE_ROWS) + 1;
+    if (total_pages < 1) total_pages = 1;
+    
+    char footer_text[64];
+    if (list_w < 320)
+        snprintf(footer_text, sizeof(footer_text), "%s[%d/%d]", list_x ? "" : "TAB C:Copy M:Move ", current_page, total_pages);
+    else
+        snprintf(footer_text, sizeof(footer_text), "CTRL:Menu ENTER:Open Q:Exit  [%d/%d]", current_page, total_pages);
+    
+    // Fill footer
+    nio_vram_fill(list_x, footer_y * 8, list_w, 8, NIO_COLOR_GRAY);
+    nio_vram_grid_puts(list_x, 0, 0, footer_y, footer_text, NIO_COLOR_GRAY, NIO_COLOR_BLACK);
+}
+
 /*
  * Draw the list of files and directories.
  *
@@ -35,19 +116,23 @@ void ui_draw_list(file_list_t *list, int selection, int scroll_offset) {
     if (!list) return;
 
     nio_console *console = nio_get_default();
-    nio_clear(console);
+    // A pane leaves the other half of the screen alone
+    if (list_w == 320) nio_clear(console);
 
     // CRITICAL: Clear VRAM buffer to prevent artifacts (stuck selection lines)
-    nio_vram_fill(0, 0, 320, 240, NIO_COLOR_BLACK);
+    nio_vram_fill(list_x, 0, list_w, 240, NIO_COLOR_BLACK);
 
-    // 1. Draw Header (Current Path)
-    nio_color(console, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
     // 1. Draw Header (Current Path)
     nio_color(console, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
     // Fill header line
-    nio_vram_fill(0, 0, 320, 10, NIO_COLOR_BLUE);
-    // Center text vertically (offset_y=1)
-    nio_vram_grid_puts(0, 1, 0, 0, list->path, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
+    int header_bg = list_active ? NIO_COLOR_BLUE : NIO_COLOR_GRAY;
+    nio_vram_fill(list_x, 0, list_w, 10, header_bg);
+    // Center text vertically (offset_y=1). Long paths keep their tail,
+    // the folder actually shown.
+    const char *header = list->path;
+    int header_cols = list_w / NIO_CHAR_WIDTH;
+    if ((int)strlen(header) > header_cols) header += strlen(header) - header_cols;
+    nio_vram_grid_puts(list_x, 1, 0, 0, header, header_bg, NIO_COLOR_WHITE);
 
     // 2. Draw List
     nio_color(console, NIO_COLOR_BLACK, NIO_COLOR_WHITE);
@@ -58,63 +143,103 @@ void ui_draw_list(file_list_t *list, int selection, int scroll_offset) {
         int entry_idx = scroll_offset + i;
         if (entry_idx >= list->count) break;
         
-        file_entry_t *entry = &list->entries[entry_idx];
-        
-        int is_selected = (entry_idx == selection);
-        
-        // Pixel y position of the row (Row 1 * 8 + 2px offset = 10px start)
-        int row_y_px = (list_y_start + i) * 8 + 2;
-
-        // Setup colors for this row
-        if (is_selected) {
-             nio_color(console, NIO_COLOR_CYAN, NIO_COLOR_BLACK);
-             // Fill selection background
-             nio_vram_fill(0, row_y_px, 320, 8, NIO_COLOR_CYAN);
-        } else {
-             nio_color(console, NIO_COLOR_BLACK, NIO_COLOR_WHITE);
-        }
-        
-        // Construct line with name and size - consistent format for all entries
-        // Format: "[icon] [name padded to 25 chars] [size/type padded to 8 chars]"
-        char line[64];
-        char size_str[16] = "";
-        
-        if (entry->is_dir) {
-            if (strcmp(entry->name, "..") == 0) {
-                snprintf(line, sizeof(line), "/ %-25s %8s", "..", "<UP>");
-            } else {
-                snprintf(line, sizeof(line), "/ %-25s %8s", entry->name, "<DIR>");
-            }
-        } else {
-            format_file_size(entry->size, size_str, sizeof(size_str));
-            snprintf(line, sizeof(line), "  %-25s %8s", entry->name, size_str);
-        }
-        
-        // Use grid put with offset_y=2 to clear the header
-        nio_vram_grid_puts(0, 2, 0, list_y_start + i, line, 
-                           is_selected ? NIO_COLOR_CYAN : NIO_COLOR_BLACK, 
-                           is_selected ? NIO_COLOR_BLACK : NIO_COLOR_WHITE);
+        draw_list_row(list, entry_idx, list_y_start + i, entry_idx == selection);
     }
     
     // 3. Draw Footer (Instructions + Page indicator)
-    int footer_y = 29; // Approx bottom
+    draw_list_footer(list, scroll_offset);
     
-    // Calculate page info
-    int total_pages = (list->count + MAX_VISIBLE_ROWS - 1) / MAX_VISIBLE_ROWS;
-    int current_page = (scroll_offset / MAX_VISIBLE_ROWS) + 1;
-    if (total_pages < 1) total_pages = 1;
+    // Force draw
+    nio_vram_draw();
+}
+
+/*
+ * Move the selection highlight within the current page.
+ * Only the rows of the old and new selection are repainted.
+ */
+void ui_update_list_selection(file_list_t *list, int old_selection, int selection, int scroll_offset) {
+    if (!list) return;
     
-    char footer_text[64];
-    snprintf(footer_text, sizeof(footer_text), "CTRL:Menu ENTER:Open Q:Exit  [%d/%d]", current_page, total_pages);
+    if (old_selection >= scroll_offset && old_selection < scroll_offset + MAX_VISIBLE_ROWS &&
+        old_selection < list->count) {
+        draw_list_row(list, old_selection, 1 + old_selection - scroll_offset, 0);
+    }
+    draw_list_row(list, selection, 1 + selection - scroll_offset, 1);
     
-    // Fill footer
-    nio_vram_fill(0, footer_y * 8, 320, 8, NIO_COLOR_GRAY);
-    nio_vram_grid_puts(0, 0, 0, footer_y, footer_text, NIO_COLOR_GRAY, NIO_COLOR_BLACK);
+    nio_vram_draw();
+}
+
+/*
+ * The list scrolled down by one entry (scroll_offset was just
+ * incremented). The visible rows are shifted up by one text row in
+ * the VRAM buffer and only the exposed bottom row and the previous
+ * selection are repainted.
+ */
+void ui_scroll_list_down(file_list_t *list, int old_selection, int selection, int scroll_offset) {
+    if (!list) return;
+    
+    nio_vram_scroll(list_x, 10, list_w, MAX_VISIBLE_ROWS * 8, 8, NIO_COLOR_BLACK);
+    
+    if (old_selection >= scroll_offset) {
+        draw_list_row(list, old_selection, 1 + old_selection - scroll_offset, 0);
+    }
+    draw_list_row(list, selection, 1 + selection - scroll_offset, 1);
+    draw_list_footer(list, scroll_offset);
     
-    // Force draw
     nio_vram_draw();
 }
 
+/*
+ * Select the screen area of the list calls that follow.
+ */
+void ui_set_list_pane(int pane, int active) {
+    list_x = pane == UI_PANE_RIGHT ? 160 : 0;
+    list_w = pane == UI_PANE_FULL ? 320 : 160;
+    list_active = active;
+}
+
+/*
+ * Move the selection of a list view by one entry, repainting only
+ * the rows involved (scrolling up needs a full redraw, since nio
+ * can only shift the VRAM up).
+ */
+int ui_list_key(file_list_t *list, int key, int *selection, int *scroll_offset) {
+    int old_selection = *selection;
+    
+    if (key == NIO_KEY_DOWN) {
+        if (*selection >= list->count - 1) return 1;
+        (*selection)++;
+        if (*selection >= *scroll_offset + MAX_VISIBLE_ROWS) {
+            (*scroll_offset)++;
+            ui_scroll_list_down(list, old_selection, *selection, *scroll_offset);
+        } else {
+            ui_update_list_selection(list, old_selection, *selection, *scroll_offset);
+        }
+        return 1;
+    }
+    if (key == NIO_KEY_UP) {
+        if (*selection <= 0) return 1;
+        (*selection)--;
+        if (*selection < *scroll_offset) {
+            (*scroll_offset)--;
+            return 2;
+        }
+        ui_update_list_selection(list, old_selection, *selection, *scroll_offset);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Shift a band of the VRAM buffer (full width, rows y..y+h) up by
+ * `pixels` with one block move, filling the exposed strip with bg.
+ * Lets views scroll by a text row without repainting what is
+ * still visible.
+ */
+void ui_shift_up(int y, int h, int pixels, unsigned char bg) {
+    nio_vram_scroll(0, y, 320, h, pixels, bg);
+}
+
 /*
  * Takes a message string and draws a modal dialog with the message and
  * two options ("Yes" and "No") in the VRAM buffer. Very helpful for
@@ -154,6 +279,69 @@ void ui_draw_modal(const char *msg) {
     nio_vram_draw();
 }
 
+/*
+ * Draw a progress box over the current screen: the label with the
+ * percentage, and a bar. Callers redraw it as the percentage changes.
+ */
+void ui_draw_progress(const char *label, int percent) {
+    int w = 240;
+    int h = 60;
+    int x = (320 - w) / 2;
+    int y = (240 - h) / 2;
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+    
+    nio_vram_fill(x - 2, y - 2, w + 4, h + 4, NIO_COLOR_BLACK);
+    nio_vram_fill(x, y, w, h, NIO_COLOR_WHITE);
+    
+    char text[64];
+    snprintf(text, sizeof(text), "%s %d%%", label, percent);
+    nio_vram_grid_puts(x + 10, y + 12, 0, 0, text, NIO_COLOR_WHITE, NIO_COLOR_BLACK);
+    
+    int bar_w = w - 20;
+    nio_vram_fill(x + 10, y + 34, bar_w, 12, NIO_COLOR_GRAY);
+    nio_vram_fill(x + 10, y + 34, bar_w * percent / 100, 12, NIO_COLOR_BLUE);
+    
+    nio_vram_draw();
+}
+
+/*
+ * Draw the status line between the list and the footer. It spans
+ * both panes, so callers draw it after the lists.
+ */
+void ui_draw_status(const char *text) {
+    int status_y = 27; // Below the last list row
+    
+    if (!text[0]) {
+        nio_vram_fill(0, status_y * 8, 320, 8, NIO_COLOR_BLACK);
+    } else {
+        nio_vram_fill(0, status_y * 8, 320, 8, NIO_COLOR_BLUE);
+        nio_vram_grid_puts(0, 0, 0, status_y, text, NIO_COLOR_BLUE, NIO_COLOR_WHITE);
+    }
+    nio_vram_draw();
+}
+
+/*
+ * Draw a box with one line of text per entry of lines, left-aligned
+ * and vertically centered as a whole.
+ */
+void ui_draw_lines(const char **lines, int count) {
+    if (count > 20) count = 20;
+    int w = 300;
+    int h = count * 10 + 20;
+    int x = (320 - w) / 2;
+    int y = (240 - h) / 2;
+    
+    nio_vram_fill(x - 2, y - 2, w + 4, h + 4, NIO_COLOR_BLACK);
+    nio_vram_fill(x, y, w, h, NIO_COLOR_WHITE);
+    
+    for (int i = 0; i < count; i++) {
+        nio_vram_grid_puts(x + 10, y + 10 + i * 10, 0, 0, lines[i], NIO_COLOR_WHITE, NIO_COLOR_BLACK);
+    }
+    
+    nio_vram_draw();
+}
+
 /*
  * Draw a menu with a list of options.
  *
@@ -319,3 +507,134 @@ int ui_get_confirmation(const char *msg) {
         }
     }
 }
+
+/*
+ * Fill a rectangle of an RGB565 screen buffer.
+ */
+static void fill_rgb565(uint16_t *screen, int x, int y, int w, int h, uint16_t color) {
+    for (int j = 0; j < h; j++) {
+        uint16_t *p = screen + (y + j) * 320 + x;
+        for (int i = 0; i < w; i++) p[i] = color;
+    }
+}
+
+/*
+ * Draw one grid cell: frame (selection or background) and thumbnail.
+ */
+static void draw_grid_cell(uint16_t *screen, int cell, const uint16_t *thumb, int selected) {
+    int x = (cell % GRID_COLS) * GRID_CELL_W;
+    int y = (cell / GRID_COLS) * GRID_CELL_H;
+    int tx = x + (GRID_CELL_W - THUMB_W) / 2;
+    int ty = y + (GRID_CELL_H - THUMB_H) / 2;
+    
+    fill_rgb565(screen, x, y, GRID_CELL_W, GRID_CELL_H, selected ? GRID_SELECT : GRID_BG);
+    if (thumb) {
+        for (int j = 0; j < THUMB_H; j++) {
+            memcpy(screen + (ty + j) * 320 + tx, thumb + j * THUMB_W, THUMB_W * sizeof(uint16_t));
+        }
+    } else {
+        fill_rgb565(screen, tx, ty, THUMB_W, THUMB_H, GRID_MISSING);
+    }
+}
+
+/*
+ * Thumbnail grid of the images in a file list.
+ *
+ * Shows GRID_PAGE thumbnails per page, taken from the thumbnail
+ * cache or decoded on first sight (the page is blitted after each
+ * decode so progress is visible). Thumbnails of the current page
+ * stay in memory, so moving the selection only redraws two cells.
+ * Returns the list index of the image picked with Enter, or -1.
+ */
+int ui_thumbnail_grid(file_list_t *list, int selection) {
+    if (!list) return -1;
+    
+    int *images = malloc((list->count + 1) * sizeof(int));
+    uint16_t *screen = malloc(320 * 240 * sizeof(uint16_t));
+    uint16_t *thumbs = malloc(GRID_PAGE * THUMB_W * THUMB_H * sizeof(uint16_t));
+    if (!images || !screen || !thumbs) {
+        free(images);
+        free(screen);
+        free(thumbs);
+        ui_draw_modal("Error: Out of memory.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return -1;
+    }
+    
+    int count = 0, sel = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (list->entries[i].is_dir || !image_viewer_is_image(list->entries[i].name)) continue;
+        if (i == selection) sel = count;
+        images[count++] = i;
+    }
+    if (count == 0) {
+        free(images);
+        free(screen);
+        free(thumbs);
+        ui_draw_modal("No images in this folder.");
+        wait_key_pressed();
+        wait_no_key_pressed();
+        return -1;
+    }
+    
+    int result = -1;
+    int page = -1;
+    int prev_sel = sel;
+    unsigned int valid = 0; // Bit per cell: thumbnail decoded
+    
+    while (1) {
+        if (sel / GRID_PAGE != page) {
+            // Load a new page
+            page = sel / GRID_PAGE;
+            valid = 0;
+            fill_rgb565(screen, 0, 0, 320, 240, GRID_BG);
+            
+            for (int c = 0; c < GRID_PAGE && page * GRID_PAGE + c < count; c++) {
+                file_entry_t *entry = &list->entries[images[page * GRID_PAGE + c]];
+                uint16_t *thumb = thumbs + c * THUMB_W * THUMB_H;
+                char path[1024];
+                if (strcmp(list->path, "/") == 0)
+                    snprintf(path, sizeof(path), "/%s", entry->name);
+                else
+                    snprintf(path, sizeof(path), "%s/%s", list->path, entry->name);
+                
+                if (thumbs_get(path, entry->size, entry->mtime, thumb) == 0) valid |= 1u << c;
+                draw_grid_cell(screen, c, (valid & (1u << c)) ? thumb : NULL, page * GRID_PAGE + c == sel);
+                lcd_blit(screen, SCR_320x240_565);
+            }
+        } else if (sel != prev_sel) {
+            int old_c = prev_sel % GRID_PAGE;
+            int new_c = sel % GRID_PAGE;
+            draw_grid_cell(screen, old_c, (valid & (1u << old_c)) ? thumbs + old_c * THUMB_W * THUMB_H : NULL, 0);
+            draw_grid_cell(screen, new_c, (valid & (1u << new_c)) ? thumbs + new_c * THUMB_W * THUMB_H : NULL, 1);
+            lcd_blit(screen, SCR_320x240_565);
+        }
+        prev_sel = sel;
+        
+        int k = input_get_key();
+        if (k == NIO_KEY_ESC || k == 'q') {
+            break;
+        } else if (k == NIO_KEY_ENTER) {
+            result = images[sel];
+            break;
+        } else if (k == NIO_KEY_LEFT) {
+            if (sel > 0) sel--;
+        } else if (k == NIO_KEY_RIGHT) {
+            if (sel < count - 1) sel++;
+        } else if (k == NIO_KEY_UP) {
+            if (sel >= GRID_COLS) sel -= GRID_COLS;
+        } else if (k == NIO_KEY_DOWN) {
+            sel = (sel + GRID_COLS < count) ? sel + GRID_COLS : count - 1;
+        }
+    }
+    
+    thumbs_close();
+    free(images);
+    free(screen);
+    free(thumbs);
+    
+    // Restore NIO display
+    nio_fflush(nio_get_default());
+    return result;
+}
@@ -4,11 +4,43 @@
 #include "fs.h"
 
 void ui_draw_list(file_list_t *list, int selection, int scroll_offset);
+void ui_update_list_selection(file_list_t *list, int old_selection, int selection, int scroll_offset);
+void ui_scroll_list_down(file_list_t *list, int old_selection, int selection, int scroll_offset);
+
+#define UI_PANE_FULL 0
+#define UI_PANE_LEFT 1
+#define UI_PANE_RIGHT 2
+
+// Two-pane mode: the list calls above draw into the given half of
+// the screen until UI_PANE_FULL is set again. The inactive pane is
+// drawn with a gray header and cursor.
+void ui_set_list_pane(int pane, int active);
+
+// Up/Down handling for list views. Returns 0 if key is not a
+// navigation key, 1 if it was handled and the screen is up to date,
+// 2 if the list needs a full ui_draw_list.
+int ui_list_key(file_list_t *list, int key, int *selection, int *scroll_offset);
+
+// Shift a full-width VRAM band up, filling the exposed strip with bg
+void ui_shift_up(int y, int h, int pixels, unsigned char bg);
 void ui_draw_modal(const char *msg);
+
+// Box with a label and a bar filled to percent, for long operations
+void ui_draw_progress(const char *label, int percent);
+
+// One full-width line above the footer, for background jobs. An
+// empty text clears it.
+void ui_draw_status(const char *text);
+
+// Box with several lines of text (up to 20), for results and details
+void ui_draw_lines(const char **lines, int count);
 void ui_draw_menu(const char **options, int count, int selection);
 int ui_get_string(const char *prompt, char *buffer, int max_len);
 
 // Returns 1 for Yes, 0 for No/Esc
 int ui_get_confirmation(const char *msg);
 
+// Thumbnail grid of the images in list. Returns the picked entry or -1.
+int ui_thumbnail_grid(file_list_t *list, int selection);
+
 #endif
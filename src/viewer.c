@@ -5,7 +5,16 @@
  * Displays offset, hex bytes, and ASCII representation.
  * If the a character is not printable, it is displayed as a dot.
  *
- * Controls: Up/Down=Line scroll, Left/Right=Page scroll, Esc=Exit
+ * Three layouts are available (M cycles them):
+ * - 8 bytes per line with the ASCII column (default)
+ * - 16 bytes per line, hex only, grouped in 16-bit words
+ * - Dense: 32 bytes per line in a 3x5 pixel font
+ *
+ * A cursor byte is tracked and decoded in the inspector line
+ * (u8, u16, u32 and f32, little endian like the Nspire CPU).
+ *
+ * Controls: Up/Down=Line, Left/Right=Page, 4/6=Byte,
+ *           M=Layout, G=Goto, Esc=Exit
  */
 
 #include <nspireio/nspireio.h>
@@ -16,8 +25,42 @@
 #include "ui.h"
 #include "input.h"
 
-#define BYTES_PER_LINE 8
-#define VISIBLE_LINES 25
+#define MAX_BYTES_PER_LINE 32
+#define MAX_VISIBLE_LINES 33
+#define TEXT_TOP 12
+#define INSPECTOR_Y 214
+
+// Small font metrics (dense layout)
+#define SMALL_ADVANCE 4
+#define SMALL_SPACE 1
+#define SMALL_LINE_HEIGHT 6
+
+typedef struct {
+    int bytes_per_line;
+    int visible_lines;
+    int line_height;
+    int small_font;
+} hex_layout_t;
+
+static const hex_layout_t layouts[] = {
+    {  8, 25, 8, 0 },                    // 8 bytes + ASCII
+    { 16, 25, 8, 0 },                    // 16 bytes, hex words
+    { 32, 33, SMALL_LINE_HEIGHT, 1 },    // Dense small font
+};
+
+#define LAYOUT_COUNT ((int)(sizeof(layouts) / sizeof(layouts[0])))
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/*
+ * 3x5 glyphs for the hex digits, one octal digit per pixel row
+ * (MSB = leftmost pixel). Only the characters the dense layout
+ * can emit are needed.
+ */
+static const unsigned short small_glyphs[16] = {
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111,
+    075757, 075717, 025755, 065656, 034443, 065556, 074647, 074644
+};
 
 // Helper from ui.c if we wanted to share, but for now we'll do a simple local version
 // to avoid linker complexity if ui.c changes.
@@ -31,72 +74,259 @@ static void format_size_local(unsigned int size, char *buf, size_t buf_size) {
     }
 }
 
+/*
+ * Write `digits` hex digits of `value` to p, most significant first.
+ * Returns the position after the last digit.
+ */
+static char *put_hex(char *p, unsigned long value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        p[i] = hex_digits[value & 0xF];
+        value >>= 4;
+    }
+    return p + digits;
+}
+
+/*
+ * Format one row of the dump in a single pass.
+ *
+ * The row is written as up to three NUL-separated segments (offset,
+ * hex, ASCII) so each can be drawn in its own colour without
+ * re-formatting. seg[] receives the start index of each segment;
+ * seg[2] is -1 when the layout has no ASCII column.
+ */
+static void format_row(char *row, int seg[3], const hex_layout_t *layout,
+                       long line_offset, const unsigned char *bytes, int count) {
+    char *p = row;
+
+    // Offset column
+    seg[0] = 0;
+    if (layout->small_font) {
+        p = put_hex(p, (unsigned long)line_offset, 6);
+        *p++ = ' ';
+        *p++ = ' ';
+    } else {
+        p = put_hex(p, (unsigned long)line_offset, 8);
+        *p++ = ':';
+    }
+    *p++ = '\0';
+
+    // Hex column
+    seg[1] = p - row;
+    for (int i = 0; i < count; i++) {
+        unsigned char b = bytes[i];
+        *p++ = hex_digits[b >> 4];
+        *p++ = hex_digits[b & 0xF];
+        // The 16 layout groups bytes into 16-bit words
+        if (layout->bytes_per_line != 16 || (i & 1)) *p++ = ' ';
+    }
+    *p++ = '\0';
+
+    // ASCII column (8-byte layout only)
+    seg[2] = -1;
+    if (layout->bytes_per_line == 8) {
+        seg[2] = p - row;
+        for (int i = 0; i < count; i++) {
+            *p++ = (bytes[i] >= 32 && bytes[i] <= 126) ? bytes[i] : '.';
+        }
+        *p = '\0';
+    }
+}
+
+/*
+ * Draw a string in the 3x5 font. Only hex digits and spaces are
+ * expected; spaces advance a single pixel so bytes stay compact.
+ * Returns the x position after the last character.
+ */
+static int draw_small_text(int x, int y, const char *s, unsigned color) {
+    for (; *s; s++) {
+        if (*s == ' ') {
+            x += SMALL_SPACE;
+            continue;
+        }
+        int digit = (*s <= '9') ? *s - '0' : *s - 'A' + 10;
+        unsigned short glyph = small_glyphs[digit & 0xF];
+        for (int row = 0; row < 5; row++) {
+            int bits = (glyph >> ((4 - row) * 3)) & 7;
+            if (bits & 4) nio_vram_pixel_set(x, y + row, color);
+            if (bits & 2) nio_vram_pixel_set(x + 1, y + row, color);
+            if (bits & 1) nio_vram_pixel_set(x + 2, y + row, color);
+        }
+        x += SMALL_ADVANCE;
+    }
+    return x;
+}
+
+/*
+ * Pixel x of byte `col` in the hex column for the given layout.
+ */
+static int hex_column_x(const hex_layout_t *layout, int col) {
+    if (layout->small_font) {
+        // Offset "XXXXXX  " = 6 digits + 2 thin spaces
+        return 6 * SMALL_ADVANCE + 2 * SMALL_SPACE + col * (2 * SMALL_ADVANCE + SMALL_SPACE);
+    }
+    if (layout->bytes_per_line == 16) {
+        // "XXXXXXXX: " then "XXXX " words
+        return (10 + (col / 2) * 5 + (col & 1) * 2) * 6;
+    }
+    return (10 + col * 3) * 6;
+}
+
+/*
+ * Draw the inspector line decoding the bytes at the cursor.
+ * avail is the number of valid bytes starting at p.
+ */
+static void draw_inspector(long cursor, const unsigned char *p, int avail) {
+    char info[64];
+    int len = snprintf(info, sizeof(info), "@%06lX", cursor);
+
+    if (avail >= 1) {
+        len += snprintf(info + len, sizeof(info) - len, " u8:%u '%c'", p[0],
+                        (p[0] >= 32 && p[0] <= 126) ? p[0] : '.');
+    }
+    if (avail >= 2) {
+        unsigned int u16 = p[0] | (p[1] << 8);
+        len += snprintf(info + len, sizeof(info) - len, " u16:%u", u16);
+    }
+    if (avail >= 4) {
+        unsigned long u32 = (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+                            ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+        float f32;
+        memcpy(&f32, p, sizeof(f32));
+        len += snprintf(info + len, sizeof(info) - len, " u32:%lu f:%.3g", u32, (double)f32);
+    }
+
+    nio_vram_fill(0, INSPECTOR_Y, 320, 9, NIO_COLOR_LIGHTBLACK);
+    nio_vram_grid_puts(0, INSPECTOR_Y + 1, 0, 0, info, NIO_COLOR_LIGHTBLACK, NIO_COLOR_WHITE);
+}
+
 /*
  * Logic for the hex dump.
  *
- * Takes a file pointer, an offset, a file size, and a title,
- * and draws the hex dump in the VRAM buffer.
+ * Takes a file pointer, an offset, a cursor, a file size, a layout
+ * and a title, and draws the hex dump in the VRAM buffer. The whole
+ * screen is fetched with a single fread.
+ *
+ * If first_line is non-zero the view just scrolled down by one line:
+ * the text area is shifted up in VRAM and only lines from first_line
+ * on are repainted.
  */
- 
-static void viewer_draw(FILE *f, long offset, long file_size, const char *title) {
-    nio_console *console = nio_get_default();
-    nio_clear(console);
-    
+
+static void viewer_draw(FILE *f, long offset, long cursor, long file_size,
+                        const hex_layout_t *layout, const char *title, int first_line) {
+    if (!first_line) {
+        nio_console *console = nio_get_default();
+        nio_clear(console);
+    }
+
     // Header
     nio_vram_fill(0, 0, 320, 10, NIO_COLOR_MAGENTA);
     nio_vram_grid_puts(0, 0, 0, 0, title, NIO_COLOR_MAGENTA, NIO_COLOR_WHITE);
-    
+
     // Offset info
     char info[64];
     char size_buf[32];
     format_size_local(file_size, size_buf, sizeof(size_buf));
     snprintf(info, sizeof(info), "%08lX/%08lX (%s)", offset, file_size, size_buf);
     nio_vram_grid_puts(120, 0, 0, 0, info, NIO_COLOR_MAGENTA, NIO_COLOR_WHITE);
-    
-    // Seek to offset
+
+    // Read the visible page plus a few bytes for the inspector
+    unsigned char page[MAX_BYTES_PER_LINE * MAX_VISIBLE_LINES + 4];
+    int page_bytes = layout->bytes_per_line * layout->visible_lines;
     fseek(f, offset, SEEK_SET);
-    
+    int bytes_read = fread(page, 1, page_bytes + 4, f);
+
+    // Text area background
+    if (first_line) {
+        // The small font highlight starts one pixel above the line
+        ui_shift_up(TEXT_TOP - layout->small_font, layout->visible_lines * layout->line_height,
+                    layout->line_height, NIO_COLOR_WHITE);
+    } else {
+        nio_vram_fill(0, 10, 320, INSPECTOR_Y - 10, NIO_COLOR_WHITE);
+    }
+
     // Draw hex dump
-    for (int line = 0; line < VISIBLE_LINES; line++) {
-        int y = 12 + (line * 8);
-        long line_offset = offset + (line * BYTES_PER_LINE);
-        
-        if (line_offset >= file_size) break;
-        
-        // Offset column (8-digit) - Starts at col 0
-        char addr[16];
-        snprintf(addr, sizeof(addr), "%08lX:", line_offset);
-        nio_vram_grid_puts(0, y, 0, 0, addr, NIO_COLOR_WHITE, NIO_COLOR_BLUE);
-        
-        // Read bytes
-        unsigned char buf[BYTES_PER_LINE];
-        int bytes_read = fread(buf, 1, BYTES_PER_LINE, f);
-        
-        // Hex column (8 bytes) - Starts at col 10 (60px)
-        char hex[64] = "";
-        for (int i = 0; i < bytes_read; i++) {
-            char byte_hex[4];
-            snprintf(byte_hex, sizeof(byte_hex), "%02X ", buf[i]);
-            strcat(hex, byte_hex);
+    char row[MAX_BYTES_PER_LINE * 4 + 16];
+    int seg[3];
+    for (int line = first_line; line < layout->visible_lines; line++) {
+        int y = TEXT_TOP + (line * layout->line_height);
+        int start = line * layout->bytes_per_line;
+        long line_offset = offset + start;
+
+        if (start >= bytes_read || start >= page_bytes) break;
+
+        if (first_line) {
+            nio_vram_fill(0, y - layout->small_font, 320, layout->line_height, NIO_COLOR_WHITE);
+        }
+
+        int count = bytes_read - start;
+        if (count > layout->bytes_per_line) count = layout->bytes_per_line;
+
+        int cursor_col = -1;
+        if (cursor >= line_offset && cursor < line_offset + count) {
+            cursor_col = cursor - line_offset;
+        }
+
+        format_row(row, seg, layout, line_offset, page + start, count);
+
+        if (layout->small_font) {
+            if (cursor_col >= 0) {
+                nio_vram_fill(hex_column_x(layout, cursor_col) - 1, y - 1,
+                              2 * SMALL_ADVANCE + 1, SMALL_LINE_HEIGHT, NIO_COLOR_GREEN);
+            }
+            draw_small_text(0, y, row + seg[0], NIO_COLOR_BLUE);
+            draw_small_text(hex_column_x(layout, 0), y, row + seg[1], NIO_COLOR_GREEN);
+            if (cursor_col >= 0) {
+                char cell[3] = { row[seg[1] + cursor_col * 3], row[seg[1] + cursor_col * 3 + 1], '\0' };
+                draw_small_text(hex_column_x(layout, cursor_col), y, cell, NIO_COLOR_WHITE);
+            }
+            continue;
+        }
+
+        nio_vram_grid_puts(0, y, 0, 0, row + seg[0], NIO_COLOR_WHITE, NIO_COLOR_BLUE);
+        nio_vram_grid_puts(hex_column_x(layout, 0), y, 0, 0, row + seg[1], NIO_COLOR_WHITE, NIO_COLOR_GREEN);
+        if (seg[2] >= 0) {
+            nio_vram_grid_puts(216, y, 0, 0, row + seg[2], NIO_COLOR_WHITE, NIO_COLOR_CYAN);
         }
-        nio_vram_grid_puts(60, y, 0, 0, hex, NIO_COLOR_WHITE, NIO_COLOR_GREEN);
-        
-        // ASCII column - Starts at col 36 (216px)
-        char ascii[BYTES_PER_LINE + 1];
-        for (int i = 0; i < bytes_read; i++) {
-            ascii[i] = (buf[i] >= 32 && buf[i] <= 126) ? buf[i] : '.';
+
+        // Cursor byte: redraw its two digits (and ASCII char) inverted
+        if (cursor_col >= 0) {
+            char cell[3];
+            cell[0] = hex_digits[page[start + cursor_col] >> 4];
+            cell[1] = hex_digits[page[start + cursor_col] & 0xF];
+            cell[2] = '\0';
+            nio_vram_grid_puts(hex_column_x(layout, cursor_col), y, 0, 0, cell, NIO_COLOR_GREEN, NIO_COLOR_WHITE);
+            if (seg[2] >= 0) {
+                cell[0] = row[seg[2] + cursor_col];
+                cell[1] = '\0';
+                nio_vram_grid_puts(216 + cursor_col * 6, y, 0, 0, cell, NIO_COLOR_CYAN, NIO_COLOR_WHITE);
+            }
         }
-        ascii[bytes_read] = '\0';
-        nio_vram_grid_puts(216, y, 0, 0, ascii, NIO_COLOR_WHITE, NIO_COLOR_CYAN);
     }
-    
+
+    // Inspector
+    int cursor_idx = cursor - offset;
+    int avail = bytes_read - cursor_idx;
+    draw_inspector(cursor, page + cursor_idx, avail > 4 ? 4 : avail);
+
     // Footer
     nio_vram_fill(0, 230, 320, 10, NIO_COLOR_GRAY);
-    nio_vram_grid_puts(0, 231, 0, 0, "Up/Down:Line L/R:Page G:Goto Esc:Exit", NIO_COLOR_GRAY, NIO_COLOR_WHITE);
-    
+    nio_vram_grid_puts(0, 231, 0, 0, "Arrows:Move 4/6:Byte M:Mode G:Goto Esc:Exit", NIO_COLOR_GRAY, NIO_COLOR_WHITE);
+
     nio_vram_draw();
 }
 
+/*
+ * Adjust offset so the cursor line is on screen.
+ */
+static long viewer_follow_cursor(long offset, long cursor, const hex_layout_t *layout) {
+    long line = (cursor / layout->bytes_per_line) * layout->bytes_per_line;
+    long page_size = (long)layout->bytes_per_line * layout->visible_lines;
+
+    if (line < offset) return line;
+    if (line >= offset + page_size) return line - page_size + layout->bytes_per_line;
+    return offset;
+}
+
 /*
  * Opens a file in the hex viewer.
  *
@@ -107,46 +337,64 @@ static void viewer_draw(FILE *f, long offset, long file_size, const char *title)
 void viewer_open(const char *filepath) {
     FILE *f = fopen(filepath, "rb");
     if (!f) return;
-    
+
     // Get file size
     fseek(f, 0, SEEK_END);
     long file_size = ftell(f);
     fseek(f, 0, SEEK_SET);
-    
+
     // Extract filename for title
     const char *title = strrchr(filepath, '/');
     if (title) title++; else title = filepath;
-    
+
+    int layout_idx = 0;
     long offset = 0;
-    long page_size = BYTES_PER_LINE * VISIBLE_LINES;
-    
+    long cursor = 0;
+    long last = file_size > 0 ? file_size - 1 : 0;
+    int first_line = 0;
+
     while (1) {
-        viewer_draw(f, offset, file_size, title);
-        
+        const hex_layout_t *layout = &layouts[layout_idx];
+        long bpl = layout->bytes_per_line;
+        long page_size = bpl * layout->visible_lines;
+
+        viewer_draw(f, offset, cursor, file_size, layout, title, first_line);
+        first_line = 0;
+
         int c = input_get_key();
-        
+        long prev_offset = offset;
+
         if (c == NIO_KEY_ESC) {
             break;
         } else if (c == NIO_KEY_UP) {
-            if (offset >= BYTES_PER_LINE) {
-                offset -= BYTES_PER_LINE;
-            }
+            if (cursor >= bpl) cursor -= bpl;
         } else if (c == NIO_KEY_DOWN) {
-            if (offset + BYTES_PER_LINE < file_size) {
-                offset += BYTES_PER_LINE;
-            }
+            if (cursor + bpl <= last) cursor += bpl;
         } else if (c == NIO_KEY_LEFT) {
             // Page up
             if (offset >= page_size) {
                 offset -= page_size;
+                cursor -= page_size;
             } else {
                 offset = 0;
+                cursor %= bpl;
             }
         } else if (c == NIO_KEY_RIGHT) {
             // Page down
             if (offset + page_size < file_size) {
                 offset += page_size;
+                cursor += page_size;
+                if (cursor > last) cursor = last;
             }
+        } else if (c == '4') {
+            if (cursor > 0) cursor--;
+        } else if (c == '6') {
+            if (cursor < last) cursor++;
+        } else if (c == 'm' || c == 'M') {
+            layout_idx = (layout_idx + 1) % LAYOUT_COUNT;
+            layout = &layouts[layout_idx];
+            // Re-align the top line to the new width around the cursor
+            offset = (cursor / layout->bytes_per_line) * layout->bytes_per_line;
         } else if (c == 'g' || c == 'G') {
             char input_buf[16] = "";
             if (ui_get_string("Go to offset (hex):", input_buf, sizeof(input_buf))) {
@@ -154,11 +402,20 @@ void viewer_open(const char *filepath) {
                 if (new_offset < 0) new_offset = 0;
                 if (new_offset >= file_size) new_offset = file_size - 1;
                 if (new_offset < 0) new_offset = 0; // Handle empty files
-                
+
+                cursor = new_offset;
                 // Align to line
-                offset = (new_offset / BYTES_PER_LINE) * BYTES_PER_LINE;
+                offset = (new_offset / bpl) * bpl;
             }
         }
+
+        offset = viewer_follow_cursor(offset, cursor, layout);
+
+        // Scrolled down one line: keep what is on screen and repaint
+        // only the old and new cursor lines at the bottom
+        if (c == NIO_KEY_DOWN && offset == prev_offset + bpl) {
+            first_line = layout->visible_lines - 2;
+        }
     }
     fclose(f);
 }
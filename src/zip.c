@@ -0,0 +1,730 @@
+/*
+ * Zip archives
+ *
+ * Only the central directory is read when an archive is opened: it
+ * becomes an index of fixed-size member records plus one pool of
+ * names, and each folder of the archive is presented as a virtual
+ * file_list_t so the usual list UI can browse it. Members are
+ * extracted one at a time by streaming them from their local
+ * header through inflate to the destination file, so neither the
+ * archive nor a member is ever held in memory.
+ *
+ * Archives are written the same way: each file is streamed through
+ * deflate (or stored, for formats that are already compressed) and
+ * its local header patched with the CRC and sizes afterwards; the
+ * central directory is built in memory and written last.
+ *
+ * ZIP64 and encrypted archives are not supported.
+ */
+
+#include <nspireio/nspireio.h>
+#include <libndls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "zip.h"
+#include "inflate.h"
+#include "deflate.h"
+#include "checksum.h"
+#include "ui.h"
+#include "input.h"
+
+#define SIG_LOCAL 0x04034b50
+#define SIG_CENTRAL 0x02014b50
+#define SIG_END 0x06054b50
+
+#define END_SIZE 22
+#define CENTRAL_SIZE 46
+#define LOCAL_SIZE 30
+#define MAX_COMMENT 65535
+
+static uint16_t get16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int zip_is_archive(const char *name) {
+    int len = strlen(name);
+    if (len > 4 && strcasecmp(name + len - 4, ".tns") == 0) len -= 4;
+    return len > 4 && strncasecmp(name + len - 4, ".zip", 4) == 0;
+}
+
+/*
+ * Find the end of central directory record in the last 64 KB of
+ * the file (it is followed by a comment of up to 65535 bytes).
+ * Returns 0 and fills rec, or -1.
+ */
+static int find_end_record(FILE *f, long fsize, unsigned char *rec) {
+    long tail = fsize < END_SIZE + MAX_COMMENT ? fsize : END_SIZE + MAX_COMMENT;
+    if (tail < END_SIZE) return -1;
+
+    unsigned char *buf = malloc(tail);
+    if (!buf) return -1;
+    int found = -1;
+    if (fseek(f, fsize - tail, SEEK_SET) == 0 && fread(buf, 1, tail, f) == (size_t)tail) {
+        for (long i = tail - END_SIZE; i >= 0; i--) {
+            if (get32(buf + i) == SIG_END) {
+                memcpy(rec, buf + i, END_SIZE);
+                found = 0;
+                break;
+            }
+        }
+    }
+    free(buf);
+    return found;
+}
+
+int zip_open(const char *path, zip_archive_t *zip) {
+    memset(zip, 0, sizeof(*zip));
+    strncpy(zip->path, path, sizeof(zip->path) - 1);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+
+    unsigned char end[END_SIZE];
+    if (find_end_record(f, fsize, end) != 0) {
+        fclose(f);
+        return -1;
+    }
+    int count = get16(end + 10);
+    uint32_t cd_size = get32(end + 12);
+    uint32_t cd_offset = get32(end + 16);
+
+    // 0xFFFF/0xFFFFFFFF mean the real values are in a ZIP64 record
+    if (count == 0xFFFF || cd_offset == 0xFFFFFFFFu || (long)cd_offset + (long)cd_size > fsize) {
+        fclose(f);
+        return -1;
+    }
+
+    // Names are part of the directory, so cd_size bounds the pool
+    zip->members = malloc((count ? count : 1) * sizeof(zip_member_t));
+    zip->names = malloc(cd_size + 1);
+    if (!zip->members || !zip->names || fseek(f, cd_offset, SEEK_SET) != 0) {
+        fclose(f);
+        zip_close(zip);
+        return -1;
+    }
+
+    uint32_t used = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned char h[CENTRAL_SIZE];
+        if (fread(h, 1, CENTRAL_SIZE, f) != CENTRAL_SIZE || get32(h) != SIG_CENTRAL) break;
+        int name_len = get16(h + 28);
+        int skip = get16(h + 30) + get16(h + 32); // Extra field and comment
+        if (used + name_len + 1 > cd_size + 1) break;
+
+        zip_member_t *m = &zip->members[zip->count];
+        m->flags = get16(h + 8);
+        m->method = get16(h + 10);
+        m->crc = get32(h + 16);
+        m->csize = get32(h + 20);
+        m->usize = get32(h + 24);
+        m->offset = get32(h + 42);
+        m->time = get16(h + 12);
+        m->date = get16(h + 14);
+        m->name = used;
+        if (fread(zip->names + used, 1, name_len, f) != (size_t)name_len) break;
+        zip->names[used + name_len] = '\0';
+        used += name_len + 1;
+        zip->count++;
+
+        if (skip && fseek(f, skip, SEEK_CUR) != 0) break;
+    }
+    fclose(f);
+
+    if (zip->count != count) {
+        zip_close(zip);
+        return -1;
+    }
+    return 0;
+}
+
+void zip_close(zip_archive_t *zip) {
+    free(zip->members);
+    free(zip->names);
+    zip->members = NULL;
+    zip->names = NULL;
+    zip->count = 0;
+}
+
+/*
+ * Append an entry, growing the array by doubling like fs_scan.
+ */
+static file_entry_t *add_entry(file_list_t *list, int *capacity) {
+    if (list->count >= *capacity) {
+        int new_capacity = *capacity * 2;
+        file_entry_t *new_entries = realloc(list->entries, sizeof(file_entry_t) * new_capacity);
+        if (!new_entries) return NULL;
+        list->entries = new_entries;
+        *capacity = new_capacity;
+    }
+    file_entry_t *entry = &list->entries[list->count++];
+    memset(entry, 0, sizeof(*entry));
+    return entry;
+}
+
+int zip_list(const zip_archive_t *zip, const char *dir, file_list_t *list) {
+    fs_free(list);
+    snprintf(list->path, sizeof(list->path), "%s/%s", zip->path, dir);
+    int path_len = strlen(list->path);
+    if (path_len > 0 && list->path[path_len - 1] == '/') list->path[path_len - 1] = '\0';
+
+    int capacity = 16;
+    list->entries = malloc(sizeof(file_entry_t) * capacity);
+    if (!list->entries) return -1;
+    list->count = 0;
+
+    file_entry_t *up = add_entry(list, &capacity);
+    strcpy(up->name, "..");
+    up->is_dir = 1;
+
+    int dir_len = strlen(dir);
+    for (int i = 0; i < zip->count; i++) {
+        const zip_member_t *m = &zip->members[i];
+        const char *name = zip->names + m->name;
+        if (strncmp(name, dir, dir_len) != 0 || !name[dir_len]) continue;
+
+        const char *rest = name + dir_len;
+        const char *slash = strchr(rest, '/');
+        int len = slash ? slash - rest : (int)strlen(rest);
+        if (len == 0) continue;
+        if (len > (int)sizeof(up->name) - 1) len = sizeof(up->name) - 1;
+
+        if (slash) {
+            // Folders are implied by the member paths: list each once
+            int seen = 0;
+            for (int j = 1; j < list->count && !seen; j++) {
+                seen = list->entries[j].is_dir && strncmp(list->entries[j].name, rest, len) == 0 &&
+                       list->entries[j].name[len] == '\0';
+            }
+            if (seen) continue;
+        }
+
+        file_entry_t *entry = add_entry(list, &capacity);
+        if (!entry) return -1;
+        memcpy(entry->name, rest, len);
+        entry->name[len] = '\0';
+        entry->is_dir = slash != NULL;
+        entry->size = slash ? 0 : m->usize;
+    }
+    return 0;
+}
+
+int zip_find(const zip_archive_t *zip, const char *name) {
+    for (int i = 0; i < zip->count; i++) {
+        if (strcmp(zip->names + zip->members[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Compressed data of a member, bounded by its size
+typedef struct {
+    FILE *f;
+    uint32_t left;
+    int failed;
+} member_in_t;
+
+// Destination file and the CRC of what was written
+typedef struct {
+    FILE *f;
+    uint32_t crc;
+    uint32_t size;
+} member_out_t;
+
+static int member_read(void *user, unsigned char *buf, int size) {
+    member_in_t *in = (member_in_t *)user;
+    if ((uint32_t)size > in->left) size = in->left;
+    if (size == 0) return 0;
+    int n = fread(buf, 1, size, in->f);
+    if (n <= 0) {
+        in->failed = 1; // Archive shorter than its directory says
+        return -1;
+    }
+    in->left -= n;
+    return n;
+}
+
+static int member_write(void *user, const unsigned char *buf, int size) {
+    member_out_t *out = (member_out_t *)user;
+    out->crc = checksum_crc32(out->crc, buf, size);
+    out->size += size;
+    return fwrite(buf, 1, size, out->f) == (size_t)size ? 0 : -1;
+}
+
+/*
+ * Decode member m from in, positioned at the start of its data.
+ * Closes in.
+ */
+static int extract_data(FILE *in, const zip_member_t *m, const char *dst_path) {
+    FILE *out = fopen(dst_path, "wb");
+    if (!out) {
+        fclose(in);
+        return ZIP_ERR_CREATE;
+    }
+
+    member_in_t src = { in, m->csize, 0 };
+    member_out_t dst = { out, 0, 0 };
+    int res = 0;
+    if (m->method == 8) {
+        int r = inflate_stream(member_read, &src, member_write, &dst);
+        if (r == INFLATE_ERR_DATA || r == INFLATE_ERR_MEM) res = ZIP_ERR_DATA;
+        else if (r != INFLATE_OK) res = src.failed ? ZIP_ERR_READ : ZIP_ERR_WRITE;
+    } else {
+        unsigned char buf[4096];
+        int n;
+        while (res == 0 && (n = member_read(&src, buf, sizeof(buf))) != 0) {
+            if (n < 0) res = ZIP_ERR_READ;
+            else if (member_write(&dst, buf, n) != 0) res = ZIP_ERR_WRITE;
+        }
+    }
+    if (res == 0 && (dst.size != m->usize || dst.crc != m->crc)) res = ZIP_ERR_DATA;
+
+    fclose(in);
+    fclose(out);
+    if (res != 0) remove(dst_path); // Never leave a partial member behind
+    return res;
+}
+
+int zip_extract(const zip_archive_t *zip, int member, const char *dst_path) {
+    const zip_member_t *m = &zip->members[member];
+    if ((m->flags & 1) || (m->method != 0 && m->method != 8)) return ZIP_ERR_METHOD;
+
+    FILE *in = fopen(zip->path, "rb");
+    if (!in) return ZIP_ERR_READ;
+
+    // The local header repeats the name and has its own extra field
+    unsigned char h[LOCAL_SIZE];
+    if (fseek(in, m->offset, SEEK_SET) != 0 || fread(h, 1, LOCAL_SIZE, in) != LOCAL_SIZE ||
+        get32(h) != SIG_LOCAL || fseek(in, get16(h + 26) + get16(h + 28), SEEK_CUR) != 0) {
+        fclose(in);
+        return ZIP_ERR_READ;
+    }
+    return extract_data(in, m, dst_path);
+}
+
+int zip_extract_data(const char *path, const zip_member_t *m, long data_offset, const char *dst_path) {
+    if ((m->flags & 1) || (m->method != 0 && m->method != 8)) return ZIP_ERR_METHOD;
+
+    FILE *in = fopen(path, "rb");
+    if (!in) return ZIP_ERR_READ;
+    if (fseek(in, data_offset, SEEK_SET) != 0) {
+        fclose(in);
+        return ZIP_ERR_READ;
+    }
+    return extract_data(in, m, dst_path);
+}
+
+/*
+ * Archive creation
+ */
+
+// Already-compressed formats are stored: deflate would not shrink them
+static const char *const stored_exts[] = { ".tns", ".png", ".jpg", ".jpeg", ".gif", ".zip", NULL };
+
+typedef struct {
+    FILE *out;
+    zip_archive_t index; // Members written so far, for the central directory
+    int capacity;
+    uint32_t names_capacity;
+    uint32_t names_used;
+    const char *skip;    // The archive itself, when it is inside the tree
+    unsigned long done, total;
+    zip_progress_fn progress;
+    void *user;
+} zip_writer_t;
+
+// File being added: feeds the encoder and tracks CRC and progress
+typedef struct {
+    FILE *f;
+    zip_writer_t *w;
+    uint32_t crc;
+    uint32_t size;
+    int failed;
+} source_t;
+
+static void put16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+static int write_all(FILE *f, const void *buf, size_t n) {
+    return fwrite(buf, 1, n, f) == n ? 0 : ZIP_ERR_WRITE;
+}
+
+static int uses_store(const char *name) {
+    const char *dot = strrchr(name, '.');
+    if (!dot) return 0;
+    for (int i = 0; stored_exts[i]; i++) {
+        if (strcasecmp(dot, stored_exts[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static void dos_datetime(time_t t, uint16_t *time, uint16_t *date) {
+    struct tm *tm = localtime(&t);
+    if (!tm || tm->tm_year < 80) {
+        *time = 0;
+        *date = (1 << 5) | 1; // 1980-01-01, the earliest DOS date
+        return;
+    }
+    *time = (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec / 2);
+    *date = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5) | tm->tm_mday;
+}
+
+/*
+ * Total size of the files under path, for progress.
+ */
+static unsigned long tree_size(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    if (!S_ISDIR(st.st_mode)) return st.st_size;
+
+    unsigned long total = 0;
+    DIR *d = opendir(path);
+    if (!d) return 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, dir->d_name);
+        total += tree_size(child);
+    }
+    closedir(d);
+    return total;
+}
+
+/*
+ * Append a member record to the index.
+ */
+static int add_record(zip_writer_t *w, const char *name, const zip_member_t *rec) {
+    zip_archive_t *z = &w->index;
+    if (z->count >= 0xFFFF) return ZIP_ERR_LIMIT;
+    if (z->count >= w->capacity) {
+        int new_capacity = w->capacity ? w->capacity * 2 : 16;
+        zip_member_t *members = realloc(z->members, new_capacity * sizeof(zip_member_t));
+        if (!members) return ZIP_ERR_MEM;
+        z->members = members;
+        w->capacity = new_capacity;
+    }
+    uint32_t len = strlen(name) + 1;
+    if (w->names_used + len > w->names_capacity) {
+        uint32_t new_capacity = w->names_capacity ? w->names_capacity * 2 : 1024;
+        while (new_capacity < w->names_used + len) new_capacity *= 2;
+        char *names = realloc(z->names, new_capacity);
+        if (!names) return ZIP_ERR_MEM;
+        z->names = names;
+        w->names_capacity = new_capacity;
+    }
+    memcpy(z->names + w->names_used, name, len);
+    z->members[z->count] = *rec;
+    z->members[z->count].name = w->names_used;
+    z->count++;
+    w->names_used += len;
+    return 0;
+}
+
+static int source_read(void *user, unsigned char *buf, int size) {
+    source_t *src = (source_t *)user;
+    int n = fread(buf, 1, size, src->f);
+    if (n == 0) {
+        if (ferror(src->f)) {
+            src->failed = 1;
+            return -1;
+        }
+        return 0;
+    }
+    src->crc = checksum_crc32(src->crc, buf, n);
+    src->size += n;
+
+    zip_writer_t *w = src->w;
+    w->done += n;
+    if (w->progress) w->progress(w->user, w->done, w->total);
+    return n;
+}
+
+static int output_write(void *user, const unsigned char *buf, int size) {
+    return fwrite(buf, 1, size, (FILE *)user) == (size_t)size ? 0 : -1;
+}
+
+/*
+ * Write one member: local header with placeholder sizes, the data
+ * (deflated or stored), then the real CRC and sizes patched in.
+ * path is NULL for a directory entry.
+ */
+static int add_member(zip_writer_t *w, const char *path, const char *name, const struct stat *st) {
+    zip_member_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.offset = ftell(w->out);
+    rec.method = (path && !uses_store(name)) ? 8 : 0;
+    dos_datetime(st->st_mtime, &rec.time, &rec.date);
+
+    unsigned char h[LOCAL_SIZE];
+    int name_len = strlen(name);
+    put32(h, SIG_LOCAL);
+    put16(h + 4, 20); // Version needed: 2.0 (deflate)
+    put16(h + 6, 0);
+    put16(h + 8, rec.method);
+    put16(h + 10, rec.time);
+    put16(h + 12, rec.date);
+    memset(h + 14, 0, 12); // CRC and sizes, patched below
+    put16(h + 26, name_len);
+    put16(h + 28, 0);
+    int res = write_all(w->out, h, LOCAL_SIZE);
+    if (res == 0) res = write_all(w->out, name, name_len);
+    if (res != 0) return res;
+    if (!path) return add_record(w, name, &rec);
+
+    FILE *in = fopen(path, "rb");
+    if (!in) return ZIP_ERR_READ;
+    source_t src = { in, w, 0, 0, 0 };
+    long data_start = ftell(w->out);
+    if (rec.method == 8) {
+        int r = deflate_stream(source_read, &src, output_write, w->out);
+        if (r == DEFLATE_ERR_MEM) res = ZIP_ERR_MEM;
+        else if (r != DEFLATE_OK) res = src.failed ? ZIP_ERR_READ : ZIP_ERR_WRITE;
+    } else {
+        unsigned char buf[4096];
+        int n;
+        while (res == 0 && (n = source_read(&src, buf, sizeof(buf))) != 0) {
+            if (n < 0) res = ZIP_ERR_READ;
+            else res = write_all(w->out, buf, n);
+        }
+    }
+    fclose(in);
+    if (res != 0) return res;
+
+    long data_end = ftell(w->out);
+    rec.crc = src.crc;
+    rec.csize = data_end - data_start;
+    rec.usize = src.size;
+    unsigned char sizes[12];
+    put32(sizes, rec.crc);
+    put32(sizes + 4, rec.csize);
+    put32(sizes + 8, rec.usize);
+    if (fseek(w->out, rec.offset + 14, SEEK_SET) != 0 || write_all(w->out, sizes, 12) != 0 ||
+        fseek(w->out, data_end, SEEK_SET) != 0) {
+        return ZIP_ERR_WRITE;
+    }
+    return add_record(w, name, &rec);
+}
+
+/*
+ * Add path under the member name `name`, recursing into directories.
+ */
+static int add_tree(zip_writer_t *w, const char *path, const char *name) {
+    struct stat st;
+    if (stat(path, &st) != 0) return ZIP_ERR_READ;
+    if (!S_ISDIR(st.st_mode)) {
+        if (strcmp(path, w->skip) == 0) return 0;
+        return add_member(w, path, name, &st);
+    }
+
+    // Directories get their own entry so empty ones survive
+    char member[1024];
+    snprintf(member, sizeof(member), "%s/", name);
+    int res = add_member(w, NULL, member, &st);
+
+    DIR *d = opendir(path);
+    if (!d) return ZIP_ERR_READ;
+    struct dirent *dir;
+    while (res == 0 && (dir = readdir(d)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) continue;
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, dir->d_name);
+        snprintf(member, sizeof(member), "%s/%s", name, dir->d_name);
+        res = add_tree(w, child, member);
+    }
+    closedir(d);
+    return res;
+}
+
+/*
+ * Central directory and end record, from the index.
+ */
+static int write_central(zip_writer_t *w) {
+    long start = ftell(w->out);
+    for (int i = 0; i < w->index.count; i++) {
+        const zip_member_t *m = &w->index.members[i];
+        const char *name = w->index.names + m->name;
+        int name_len = strlen(name);
+
+        unsigned char h[CENTRAL_SIZE];
+        memset(h, 0, sizeof(h));
+        put32(h, SIG_CENTRAL);
+        put16(h + 4, 20); // Made by: MS-DOS attributes, 2.0
+        put16(h + 6, 20);
+        put16(h + 10, m->method);
+        put16(h + 12, m->time);
+        put16(h + 14, m->date);
+        put32(h + 16, m->crc);
+        put32(h + 20, m->csize);
+        put32(h + 24, m->usize);
+        put16(h + 28, name_len);
+        put32(h + 38, name[name_len - 1] == '/' ? 0x10 : 0); // Directory attribute
+        put32(h + 42, m->offset);
+        int res = write_all(w->out, h, CENTRAL_SIZE);
+        if (res == 0) res = write_all(w->out, name, name_len);
+        if (res != 0) return res;
+    }
+
+    unsigned char end[END_SIZE];
+    memset(end, 0, sizeof(end));
+    put32(end, SIG_END);
+    put16(end + 8, w->index.count);
+    put16(end + 10, w->index.count);
+    put32(end + 12, ftell(w->out) - start);
+    put32(end + 16, start);
+    return write_all(w->out, end, END_SIZE);
+}
+
+int zip_create(const char *src_path, const char *zip_path, zip_progress_fn progress, void *user) {
+    zip_writer_t w;
+    memset(&w, 0, sizeof(w));
+    w.skip = zip_path;
+    w.progress = progress;
+    w.user = user;
+    w.total = tree_size(src_path);
+
+    w.out = fopen(zip_path, "wb");
+    if (!w.out) return ZIP_ERR_CREATE;
+
+    // Members are named from the last component of src_path
+    const char *base = strrchr(src_path, '/');
+    base = base ? base + 1 : src_path;
+    int res = add_tree(&w, src_path, base);
+    if (res == 0) res = write_central(&w);
+    if (fclose(w.out) != 0 && res == 0) res = ZIP_ERR_WRITE;
+
+    zip_close(&w.index);
+    if (res != 0) remove(zip_path);
+    return res;
+}
+
+static void show_message(const char *msg) {
+    ui_draw_modal(msg);
+    wait_key_pressed();
+    wait_no_key_pressed();
+}
+
+/*
+ * Extract the member shown as entry `name` of directory dir into
+ * the archive's folder. Returns 1 if a file was written.
+ */
+static int extract_entry(const zip_archive_t *zip, const char *dir, const char *name) {
+    char member[512];
+    snprintf(member, sizeof(member), "%s%s", dir, name);
+    int idx = zip_find(zip, member);
+    if (idx < 0) {
+        show_message("Member not found");
+        return 0;
+    }
+
+    char msg[270];
+    snprintf(msg, sizeof(msg), "Extract %s?", name);
+    if (!ui_get_confirmation(msg)) return 0;
+
+    // Next to the archive, under the member's own name
+    char target[1024];
+    char dst_path[1024];
+    const char *slash = strrchr(zip->path, '/');
+    int dir_len = slash ? (int)(slash - zip->path) : 0;
+    snprintf(target, sizeof(target), "%.*s/%s", dir_len, zip->path, name);
+    strcpy(dst_path, target);
+
+    struct stat st;
+    if (stat(target, &st) == 0 && fs_generate_copy_name(target, dst_path, sizeof(dst_path)) != 0) {
+        show_message("Too many copies");
+        return 0;
+    }
+
+    ui_draw_modal("Extracting...");
+    int res = zip_extract(zip, idx, dst_path);
+    if (res == 0) show_message("Extracted");
+    else if (res == ZIP_ERR_METHOD) show_message("Unsupported compression");
+    else if (res == ZIP_ERR_DATA) show_message("Archive is corrupt");
+    else if (res == ZIP_ERR_READ) show_message("Read failed");
+    else show_message("Write failed");
+    return res == 0;
+}
+
+int zip_browse(const char *path) {
+    zip_archive_t zip;
+    if (zip_open(path, &zip) != 0) {
+        show_message("Not a readable zip archive");
+        return 0;
+    }
+
+    char dir[256] = ""; // Current folder inside the archive, "" or ending in '/'
+    file_list_t list = {0};
+    int selection = 0;
+    int scroll_offset = 0;
+    int extracted = 0;
+    int full_redraw = 1;
+    zip_list(&zip, dir, &list);
+    fs_sort(&list, SORT_NAME);
+
+    while (1) {
+        if (full_redraw) ui_draw_list(&list, selection, scroll_offset);
+        full_redraw = 1;
+
+        int c = input_get_key();
+        int go_up = 0;
+        int nav = ui_list_key(&list, c, &selection, &scroll_offset);
+
+        if (nav) {
+            full_redraw = nav == 2;
+        } else if (c == NIO_KEY_ENTER || c == NIO_KEY_RIGHT) {
+            file_entry_t *sel = &list.entries[selection];
+            if (strcmp(sel->name, "..") == 0) {
+                go_up = 1;
+            } else if (sel->is_dir) {
+                if (strlen(dir) + strlen(sel->name) + 2 <= sizeof(dir)) {
+                    strcat(dir, sel->name);
+                    strcat(dir, "/");
+                    zip_list(&zip, dir, &list);
+                    fs_sort(&list, SORT_NAME);
+                    selection = 0;
+                    scroll_offset = 0;
+                }
+            } else {
+                extracted |= extract_entry(&zip, dir, sel->name);
+            }
+        } else if (c == NIO_KEY_ESC || c == NIO_KEY_LEFT) {
+            go_up = 1;
+        } else if (c == 'q') {
+            break;
+        } else {
+            full_redraw = 0;
+        }
+
+        if (go_up) {
+            // Leaving the root folder leaves the archive
+            if (!dir[0]) break;
+            dir[strlen(dir) - 1] = '\0';
+            char *slash = strrchr(dir, '/');
+            if (slash) slash[1] = '\0';
+            else dir[0] = '\0';
+            zip_list(&zip, dir, &list);
+            fs_sort(&list, SORT_NAME);
+            selection = 0;
+            scroll_offset = 0;
+        }
+    }
+
+    fs_free(&list);
+    zip_close(&zip);
+    return extracted;
+}
@@ -0,0 +1,70 @@
+#ifndef ZIP_H
+#define ZIP_H
+
+#include <stdint.h>
+#include "fs.h"
+
+// One member, as recorded in the central directory
+typedef struct {
+    uint32_t name;   // Offset of the NUL-terminated name in names
+    uint32_t offset; // Local header
+    uint32_t csize;
+    uint32_t usize;
+    uint32_t crc;
+    uint16_t method; // 0 = stored, 8 = deflate
+    uint16_t flags;
+    uint16_t time;   // MS-DOS format
+    uint16_t date;
+} zip_member_t;
+
+typedef struct {
+    char path[512];
+    zip_member_t *members;
+    int count;
+    char *names;
+} zip_archive_t;
+
+// Returns 1 for .zip files (and .zip.tns, the name transfers need)
+int zip_is_archive(const char *name);
+
+// Read the central directory of an archive into an index.
+// Returns 0 on success, -1 if the file is not a usable zip.
+int zip_open(const char *path, zip_archive_t *zip);
+void zip_close(zip_archive_t *zip);
+
+// Fill list with the contents of directory dir ("" for the root,
+// else ending in '/') as a virtual listing, ".." first.
+int zip_list(const zip_archive_t *zip, const char *dir, file_list_t *list);
+
+// Index of the member with this full name, or -1
+int zip_find(const zip_archive_t *zip, const char *name);
+
+#define ZIP_ERR_READ -1
+#define ZIP_ERR_CREATE -2
+#define ZIP_ERR_WRITE -3
+#define ZIP_ERR_METHOD -4 // Encrypted or not stored/deflate
+#define ZIP_ERR_DATA -5   // Corrupt data or CRC mismatch
+#define ZIP_ERR_MEM -6
+#define ZIP_ERR_LIMIT -7  // More members than a zip without ZIP64 holds
+
+// Extract one member to dst_path, streaming it through inflate.
+// Returns 0 or a ZIP_ERR_ code.
+int zip_extract(const zip_archive_t *zip, int member, const char *dst_path);
+
+// Same, for a member of a zip-like container whose data starts at
+// data_offset of the file at path (the caller parsed the headers).
+int zip_extract_data(const char *path, const zip_member_t *m, long data_offset, const char *dst_path);
+
+// Called while zip_create runs, with the bytes read so far out of total
+typedef void (*zip_progress_fn)(void *user, unsigned long done, unsigned long total);
+
+// Write a zip of src_path (a file, or a directory and everything in
+// it) to zip_path. Returns 0 or a ZIP_ERR_ code; a failed archive is
+// removed.
+int zip_create(const char *src_path, const char *zip_path, zip_progress_fn progress, void *user);
+
+// Browse an archive like a folder; Enter extracts a member next to
+// the archive. Returns 1 if anything was extracted.
+int zip_browse(const char *path);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Host benchmark for color.c: speed and quality of the RGB565
+ * conversion in each dithering mode.
+ *
+ *   make bench
+ *
+ * Quality is how far the picture drifts from the original once the
+ * eye averages neighbouring pixels: the mean absolute difference,
+ * in 8-bit levels per channel, between 8x8 block averages of the
+ * source and of the RGB565 output (expanded back to 8 bits). Speed
+ * is rows of 320 pixels converted per second on the host, which
+ * only compares the modes with each other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "color.h"
+
+#define W 320
+#define H 240
+#define BLOCK 8
+#define MIN_SECONDS 0.5
+
+static unsigned char image[H][W * 3];
+static uint16_t out[H][W];
+
+// A slow diagonal gradient: the case banding shows up on
+static void make_gradient(void) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            image[y][x * 3] = x * 255 / (W - 1);
+            image[y][x * 3 + 1] = (x + y) * 255 / (W + H - 2);
+            image[y][x * 3 + 2] = y * 255 / (H - 1);
+        }
+    }
+}
+
+// Smooth shapes with some texture, closer to a photo
+static void make_photo(void) {
+    srand(1);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            double s = sin(x * 0.031) * cos(y * 0.043);
+            double t = sin((x + y) * 0.017);
+            int noise = rand() % 9 - 4;
+            int r = (int)(128 + 100 * s) + noise;
+            int g = (int)(128 + 90 * t) + noise;
+            int b = (int)(128 + 60 * (s - t)) + noise;
+            image[y][x * 3] = r < 0 ? 0 : (r > 255 ? 255 : r);
+            image[y][x * 3 + 1] = g < 0 ? 0 : (g > 255 ? 255 : g);
+            image[y][x * 3 + 2] = b < 0 ? 0 : (b > 255 ? 255 : b);
+        }
+    }
+}
+
+static void convert(int mode) {
+    color_diffuse_start();
+    for (int y = 0; y < H; y++) color_row_565(image[y], out[y], W, 0, y, mode);
+}
+
+static double block_error(void) {
+    double total = 0;
+    int count = 0;
+    for (int by = 0; by < H; by += BLOCK) {
+        for (int bx = 0; bx < W; bx += BLOCK) {
+            double src[3] = { 0, 0, 0 };
+            double dst[3] = { 0, 0, 0 };
+            for (int y = by; y < by + BLOCK; y++) {
+                for (int x = bx; x < bx + BLOCK; x++) {
+                    uint16_t p = out[y][x];
+                    int r = (p >> 11) & 31, g = (p >> 5) & 63, b = p & 31;
+                    dst[0] += (r << 3) | (r >> 2);
+                    dst[1] += (g << 2) | (g >> 4);
+                    dst[2] += (b << 3) | (b >> 2);
+                    for (int c = 0; c < 3; c++) src[c] += image[y][x * 3 + c];
+                }
+            }
+            for (int c = 0; c < 3; c++) total += fabs(src[c] - dst[c]) / (BLOCK * BLOCK);
+            count += 3;
+        }
+    }
+    return total / count;
+}
+
+static double rows_per_second(int mode) {
+    long rows = 0;
+    clock_t start = clock();
+    double elapsed;
+    do {
+        convert(mode);
+        rows += H;
+        elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < MIN_SECONDS);
+    return rows / elapsed;
+}
+
+int main(void) {
+    static const char *names[2] = { "gradient", "photo" };
+    printf("%-10s %-10s %12s %10s\n", "image", "mode", "rows/s", "error");
+    for (int i = 0; i < 2; i++) {
+        if (i == 0) make_gradient();
+        else make_photo();
+        for (int mode = 0; mode < COLOR_DITHER_COUNT; mode++) {
+            double speed = rows_per_second(mode);
+            convert(mode);
+            printf("%-10s %-10s %12.0f %10.2f\n", names[i], color_dither_name(mode), speed, block_error());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Host check for the 4bpp gray output of color.c.
+ *
+ *   make check
+ *
+ * - color_row_gray4 packs the left pixel of each byte in the high
+ *   nibble and leaves the neighbouring pixels of a partial row alone
+ * - its gray scale runs from 0 to 15, rounds without dithering, and
+ *   averages to the right level over a Bayer cell when ordered
+ * - the two ways the image viewer fills a gray screen agree: the
+ *   direct fit (luminance per source pixel, then color_row_gray4) and
+ *   the RGB565 fit converted afterwards by color_565_to_gray4 (the
+ *   zoomed views). The RGB565 step drops low bits, so levels may be
+ *   one apart, rarely.
+ *
+ * Prints each failure and exits non-zero if there was any.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "color.h"
+
+#define W 320
+#define H 240
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static int level_at(const unsigned char *row, int x) {
+    return (x & 1) ? row[x >> 1] & 0x0F : row[x >> 1] >> 4;
+}
+
+static void check_nibbles(void) {
+    unsigned char luma[4] = { 255, 255, 255, 255 };
+    unsigned char row[4];
+
+    // Pixels 1..3: the low nibble of byte 0 and all of byte 1
+    memset(row, 0x5A, sizeof(row));
+    color_row_gray4(luma, row, 3, 1, 0, COLOR_DITHER_NONE);
+    check(row[0] == 0x5F, "odd start pixel goes in the low nibble");
+    check(row[1] == 0xFF, "whole byte written");
+    check(row[2] == 0x5A, "bytes past the row untouched");
+
+    // Pixel 2 alone: the high nibble of byte 1
+    memset(row, 0x5A, sizeof(row));
+    luma[0] = 0;
+    color_row_gray4(luma, row, 1, 2, 0, COLOR_DITHER_NONE);
+    check(row[1] == 0x0A, "even pixel goes in the high nibble");
+    check(row[0] == 0x5A, "bytes before the row untouched");
+}
+
+static void check_scale(void) {
+    unsigned char luma[256];
+    unsigned char row[128];
+    for (int v = 0; v < 256; v++) luma[v] = v;
+
+    color_row_gray4(luma, row, 256, 0, 0, COLOR_DITHER_NONE);
+    check(level_at(row, 0) == 0, "black is level 0");
+    check(level_at(row, 255) == 15, "white is level 15");
+    for (int v = 0; v < 256; v++) {
+        if (v > 0 && level_at(row, v) < level_at(row, v - 1)) check(0, "levels never decrease");
+        if (fabs(level_at(row, v) - v * 15 / 255.0) > 0.5 + 1e-9) check(0, "undithered levels round");
+    }
+
+    // Ordered: a flat 4x4 cell averages to the exact level, within a threshold step
+    for (int v = 0; v < 256; v++) {
+        unsigned char flat[4] = { v, v, v, v };
+        int sum = 0;
+        for (int y = 0; y < 4; y++) {
+            color_row_gray4(flat, row, 4, 0, y, COLOR_DITHER_ORDERED);
+            for (int x = 0; x < 4; x++) sum += level_at(row, x);
+        }
+        if (fabs(sum / 16.0 - v * 15 / 255.0) > 1.0 / 16 + 1e-9) check(0, "ordered cell averages to the level");
+    }
+}
+
+static unsigned char image[H][W * 3];
+static uint16_t fit565[H * W];
+static unsigned char direct[H * W / 2];
+
+static void check_paths(int mode) {
+    srand(2);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W * 3; x++) {
+            // Gradients with noise, so every level and threshold is met
+            int v = (x / 3) * 255 / (W - 1) + (x % 3) * y / 3 + rand() % 16 - 8;
+            image[y][x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+        }
+    }
+
+    // As render_fit on a gray screen
+    unsigned char luma[W];
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const unsigned char *p = image[y] + x * 3;
+            luma[x] = COLOR_LUMA(p[0], p[1], p[2]);
+        }
+        color_row_gray4(luma, direct + y * (W / 2), W, 0, y, mode);
+    }
+
+    // As a zoomed view: RGB565 (undithered, as close to the source as
+    // it gets), then converted in place
+    for (int y = 0; y < H; y++) color_row_565(image[y], fit565 + y * W, W, 0, y, COLOR_DITHER_NONE);
+    color_565_to_gray4(fit565, (unsigned char *)fit565, W, H, mode);
+    const unsigned char *converted = (const unsigned char *)fit565;
+
+    int max_diff = 0;
+    long apart = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int d = abs(level_at(direct + y * (W / 2), x) - level_at(converted + y * (W / 2), x));
+            if (d > max_diff) max_diff = d;
+            if (d) apart++;
+        }
+    }
+    printf("%-9s gray paths: %ld of %d pixels one level apart, max %d\n",
+           color_dither_name(mode), apart, W * H, max_diff);
+    check(max_diff <= 1, "direct and converted gray within one level");
+    check(apart * 5 < W * H, "direct and converted gray mostly equal");
+}
+
+int main(void) {
+    check_nibbles();
+    check_scale();
+    check_paths(COLOR_DITHER_NONE);
+    check_paths(COLOR_DITHER_ORDERED);
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All color checks passed\n");
+    return 0;
+}